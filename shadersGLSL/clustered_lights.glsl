@@ -0,0 +1,86 @@
+// Spot lights binned into view-frustum clusters by LightClusters (src/LightClusters.h).
+// Include after uniform_blocks.glsl.
+
+struct SpotLight {
+    vec3 position;
+    float cutoff;
+    vec3 direction;
+    float outerCutoff;
+    vec3 color;
+    float radius;
+};
+
+uniform samplerBuffer lightBuffer;         // 4 texels per light, see LightClusters::Upload
+uniform usamplerBuffer clusterBuffer;      // (first index, light count) per cluster
+uniform usamplerBuffer lightIndexBuffer;   // light indices, cluster after cluster
+
+vec3 CalculateHeadlight(vec3 normal, vec3 fragPos, SpotLight headlight)
+{
+    vec3 toLight = headlight.position - fragPos;
+    float distance = length(toLight);
+    vec3 lightDirNorm = normalize(toLight);
+
+    float theta = dot(lightDirNorm, normalize(-headlight.direction));
+
+    float gaussianFactor = exp(-pow(distance / headlight.radius, 2.5));
+
+    float spotlightIntensity = smoothstep(headlight.outerCutoff, headlight.cutoff, theta);
+    spotlightIntensity = pow(spotlightIntensity, 2.0);
+
+    float halo = exp(-pow(distance / (headlight.radius * 0.7), 2.0)) * 0.2;
+
+    vec3 reflectDir = reflect(-lightDirNorm, normal);
+    float spec = pow(max(dot(normalize(viewPos - fragPos), reflectDir), 0.0), 16.0);
+
+    float fog = exp(-distance * 0.04);
+
+    return headlight.color * spotlightIntensity * gaussianFactor * (1.0 + spec + halo) * fog;
+}
+
+vec3 CalculateStreetLight(vec3 normal, vec3 fragPos, SpotLight streetLight)
+{
+    vec3 toLight = streetLight.position - fragPos;
+    float distance = length(toLight);
+    vec3 lightDirNorm = normalize(toLight);
+
+    float theta = dot(lightDirNorm, normalize(-streetLight.direction));
+
+    float spotlightIntensity = smoothstep(streetLight.outerCutoff, streetLight.cutoff, theta);
+
+    float attenuation = 1.0 / (1.0 + streetLight.radius * distance + (streetLight.radius * distance * distance));
+
+    float diff = max(dot(normal, lightDirNorm), 0.0);
+
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 reflectDir = reflect(-lightDirNorm, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+
+    vec3 ambient = streetLight.color * 0.2;
+    vec3 diffuse = streetLight.color * diff * spotlightIntensity;
+    vec3 specular = streetLight.color * spec * 0.5 * spotlightIntensity;
+
+    return ambient*attenuation + diffuse* attenuation + specular* attenuation;
+}
+
+// Sum of the lights in the cluster containing fragPos; screenPos is the window position in [0, 1].
+vec3 CalculateClusteredLights(vec3 normal, vec3 fragPos, vec2 screenPos)
+{
+    float depth = max(-(view * vec4(fragPos, 1.0)).z, 1e-4);
+    ivec2 tile = ivec2(clamp(screenPos, 0.0, 0.9999) * vec2(clusterGrid.xy));
+    int slice = clamp(int(log(depth) * clusterParams.x + clusterParams.y), 0, int(clusterGrid.z) - 1);
+    int cluster = (slice * int(clusterGrid.y) + tile.y) * int(clusterGrid.x) + tile.x;
+
+    uvec2 range = texelFetch(clusterBuffer, cluster).xy;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int index = int(texelFetch(lightIndexBuffer, int(range.x + i)).r) * 4;
+        vec4 positionCutoff = texelFetch(lightBuffer, index);
+        vec4 directionOuter = texelFetch(lightBuffer, index + 1);
+        vec4 colorRadius = texelFetch(lightBuffer, index + 2);
+        float type = texelFetch(lightBuffer, index + 3).x;
+        SpotLight light = SpotLight(positionCutoff.xyz, positionCutoff.w, directionOuter.xyz, directionOuter.w,
+                                    colorRadius.xyz, colorRadius.w);
+        result += type < 0.5 ? CalculateStreetLight(normal, fragPos, light) : CalculateHeadlight(normal, fragPos, light);
+    }
+    return result;
+}
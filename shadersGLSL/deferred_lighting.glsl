@@ -0,0 +1,40 @@
+#version 330 core
+
+// Lighting pass of the deferred path: directional light, clustered lights and fog from the G-buffer.
+out vec4 FragColor;
+
+in vec2 screenUV;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+#include "uniform_blocks.glsl"
+#include "clustered_lights.glsl"
+#include "scene_lighting.glsl"
+
+void main()
+{
+    float depth = texture(gDepth, screenUV).r;
+    if (depth >= 1.0)
+        discard;   // sky: keep the clear color
+
+    vec4 position = inverseViewProjection * vec4(vec3(screenUV, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = position.xyz / position.w;
+    vec4 albedoRoughness = texture(gAlbedo, screenUV);
+    vec4 normalLit = texture(gNormal, screenUV);
+
+    vec3 lighting;
+    if (normalLit.w < 0.5) {
+        lighting = normalLit.rgb;
+    } else {
+        vec3 normal = normalize(normalLit.xyz);
+        lighting = CalculatePhongLighting(normal, fragPos, albedoRoughness.rgb, albedoRoughness.a);
+        lighting += CalculateClusteredLights(normal, fragPos, gl_FragCoord.xy * clusterParams.zw);
+    }
+
+    // Scene depth for the forward transparent pass drawn afterwards.
+    gl_FragDepth = depth;
+    FragColor = vec4(ApplyFog(lighting, fragPos), 1.0);
+}
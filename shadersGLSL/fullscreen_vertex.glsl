@@ -0,0 +1,11 @@
+#version 330 core
+
+// One triangle covering the screen, drawn without vertex buffers.
+out vec2 screenUV;
+
+void main()
+{
+    vec2 position = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    screenUV = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
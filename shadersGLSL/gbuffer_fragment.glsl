@@ -0,0 +1,39 @@
+#version 330 core
+
+// Geometry pass of the deferred path (DeferredShading); runs after vertex_shader.glsl, compiled
+// with the same SHADING_PHONG and BUMP_MAPPING variants.
+layout (location = 0) out vec4 gAlbedo;   // rgb albedo, a roughness
+layout (location = 1) out vec4 gNormal;   // w 1: xyz world normal; w 0: Gouraud, rgb the lit color (half float, not clamped)
+
+in vec2 texCoord;
+in vec3 fragPos;
+in vec3 fragNormal;
+#ifndef SHADING_PHONG
+in vec3 gouraudColor;
+#endif
+#ifdef BUMP_MAPPING
+in mat3 TBN;
+#endif
+
+uniform sampler2D textureAlbedo;
+uniform sampler2D textureNormal;
+uniform sampler2D textureRoughness;
+
+#include "uniform_blocks.glsl"
+
+void main()
+{
+    vec3 albedo = texture(textureAlbedo, texCoord).rgb;
+    gAlbedo = vec4(albedo, texture(textureRoughness, texCoord).r);
+
+#ifdef SHADING_PHONG
+#ifdef BUMP_MAPPING
+    vec3 normal = normalize(TBN * (texture(textureNormal, texCoord).rgb * 2.0 - 1.0));
+#else
+    vec3 normal = normalize(fragNormal);
+#endif
+    gNormal = vec4(normal, 1.0);
+#else
+    gNormal = vec4(gouraudColor * albedo, 0.0);
+#endif
+}
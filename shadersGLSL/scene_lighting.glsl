@@ -0,0 +1,32 @@
+// Directional light and fog shared by the forward and deferred paths. Include after uniform_blocks.glsl.
+
+#include "shadows.glsl"
+
+vec3 CalculatePhongLighting(vec3 normal, vec3 fragPos, vec3 objectColor, float roughness)
+{
+    vec3 norm = normal;
+    vec3 lightDirNorm = normalize(-lightDir);
+
+    vec3 ambient = ambientColor * objectColor * 0.7;
+
+    float diff = max(dot(norm, lightDirNorm), 0.0);
+    vec3 diffuse = lightColor * diff * objectColor;
+
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 reflectDir = reflect(-lightDirNorm, norm);
+    float shininess = mix(4.0, 32.0, 1.0 - roughness);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = lightColor * spec * vec3(1.0);
+
+    return ambient + (diffuse + specular) * CalculateSunShadow(norm, fragPos);
+}
+
+vec3 ApplyFog(vec3 color, vec3 fragPos)
+{
+    float distance = length(viewPos - fragPos);
+
+    float fogFactor = exp(-pow(distance * fogDensity, 2.0));
+    fogFactor = clamp(fogFactor, 0.0, 1.0);
+
+    return mix(fogColor, color, fogFactor);
+}
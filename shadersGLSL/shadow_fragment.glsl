@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth is all a shadow map needs.
+void main()
+{
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// Depth-only pass into a shadow map (ShadowMaps); same model/instance inputs as vertex_shader.glsl.
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+uniform mat4 model;
+uniform bool instanced;
+uniform mat4 lightSpaceMatrix;
+
+void main()
+{
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    gl_Position = lightSpaceMatrix * modelMatrix * vec4(aPos, 1.0);
+}
@@ -0,0 +1,32 @@
+// Sun shadow from the cached static map and the per-frame dynamic layer (ShadowMaps, src/ShadowMaps.h).
+// Include after uniform_blocks.glsl.
+
+uniform sampler2DShadow staticShadowMap;
+uniform sampler2DShadow dynamicShadowMap;
+
+// 3x3 taps on top of the hardware 2x2 comparison filter.
+float SampleShadow(sampler2DShadow map, vec3 coord)
+{
+    vec2 texel = 1.0 / vec2(textureSize(map, 0));
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+            lit += texture(map, vec3(coord.xy + vec2(x, y) * texel, coord.z));
+    return lit / 9.0;
+}
+
+// 1 = fully lit by the sun, 0 = in shadow.
+float CalculateSunShadow(vec3 normal, vec3 fragPos)
+{
+    float lit = 1.0;
+    vec3 staticCoord = (staticShadowMatrix * vec4(fragPos + normal * shadowBias.x, 1.0)).xyz;
+    if (staticCoord.z <= 1.0)
+        lit = SampleShadow(staticShadowMap, vec3(staticCoord.xy, staticCoord.z - shadowBias.z));
+
+    // The dynamic layer's depth range ends right behind its casters: anything farther is clamped
+    // to the far plane, so it is shadowed wherever a caster was drawn.
+    vec3 dynamicCoord = (dynamicShadowMatrix * vec4(fragPos + normal * shadowBias.y, 1.0)).xyz;
+    if (dynamicCoord.z >= 0.0)
+        lit = min(lit, SampleShadow(dynamicShadowMap, vec3(dynamicCoord.xy, min(dynamicCoord.z, 1.0) - shadowBias.w)));
+    return lit;
+}
@@ -0,0 +1,20 @@
+// Shared by every program, filled from SceneUniformData (SceneUniforms.h) once per frame.
+
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float fogDensity;
+    vec3 fogColor;
+};
+
+layout (std140) uniform LightData {
+    vec3 lightDir;
+    vec3 lightColor;
+    vec3 ambientColor;
+    uvec4 clusterGrid;     // tiles x, tiles y, depth slices, light count
+    vec4 clusterParams;    // slice = log(depth) * x + y; z, w = 1 / viewport size
+    mat4 staticShadowMatrix;    // world to shadow map texture space
+    mat4 dynamicShadowMatrix;
+    vec4 shadowBias;       // x, y: normal offset in world units; z, w: depth bias (static, dynamic)
+};
@@ -0,0 +1,193 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+template <typename T>
+T catmullRom(const T& p0, const T& p1, const T& p2, const T& p3, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+// Nearest-rank percentile of sorted samples.
+template <typename T>
+T percentile(const std::vector<T>& sorted, double p)
+{
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+template <typename T>
+double average(const std::vector<T>& samples)
+{
+    double sum = 0.0;
+    for (T sample : samples)
+        sum += static_cast<double>(sample);
+    return samples.empty() ? 0.0 : sum / samples.size();
+}
+
+std::string jsonString(const std::string& text)
+{
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+}
+
+CameraPath::CameraPath(const std::string& name, const std::vector<CameraKey>& keys, bool looped)
+    : name(name), keys(keys), looped(looped)
+{
+}
+
+void CameraPath::Sample(float t, glm::vec3& position, glm::vec3& target) const
+{
+    const int count = static_cast<int>(keys.size());
+    const int segments = looped ? count : count - 1;
+    float x = std::min(std::max(t, 0.0f), 1.0f) * segments;
+    int segment = std::min(static_cast<int>(x), segments - 1);
+    float local = x - segment;
+
+    // Open paths repeat their end keys as the outer control points.
+    auto key = [&](int i) -> const CameraKey& {
+        if (looped)
+            return keys[((i % count) + count) % count];
+        return keys[std::min(std::max(i, 0), count - 1)];
+    };
+    const CameraKey& k0 = key(segment - 1);
+    const CameraKey& k1 = key(segment);
+    const CameraKey& k2 = key(segment + 1);
+    const CameraKey& k3 = key(segment + 2);
+    position = catmullRom(k0.position, k1.position, k2.position, k3.position, local);
+    target = catmullRom(k0.target, k1.target, k2.target, k3.target, local);
+}
+
+std::vector<CameraPath> BenchmarkPaths()
+{
+    std::vector<CameraPath> paths;
+
+    // Eye height down the car's street, then around the corner it turns at.
+    paths.emplace_back("street", std::vector<CameraKey>{
+        { glm::vec3(50.0f, 2.5f, 4.0f), glm::vec3(30.0f, 2.0f, 3.0f) },
+        { glm::vec3(25.0f, 2.5f, 4.0f), glm::vec3(5.0f, 2.0f, 3.0f) },
+        { glm::vec3(0.0f, 2.5f, 4.0f), glm::vec3(-20.0f, 2.0f, 3.0f) },
+        { glm::vec3(-25.0f, 2.5f, 4.0f), glm::vec3(-45.0f, 2.0f, 3.0f) },
+        { glm::vec3(-50.0f, 3.0f, 4.0f), glm::vec3(-70.0f, 2.0f, 8.0f) },
+        { glm::vec3(-62.0f, 3.0f, 8.0f), glm::vec3(-64.0f, 2.0f, 30.0f) },
+    }, false);
+
+    // Circling high above the middle of the city: most of it in view at once.
+    const glm::vec3 center(-5.0f, 0.0f, 0.0f);
+    std::vector<CameraKey> orbit;
+    for (int i = 0; i < 8; i++) {
+        float angle = glm::radians(45.0f * i);
+        orbit.push_back({ center + glm::vec3(70.0f * std::cos(angle), 35.0f, 70.0f * std::sin(angle)), center });
+    }
+    paths.emplace_back("overview", orbit, true);
+
+    // From the top camera's spot down between the spheres to street level.
+    paths.emplace_back("descent", std::vector<CameraKey>{
+        { glm::vec3(-68.0f, 40.0f, -11.0f), glm::vec3(-20.0f, 0.0f, 0.0f) },
+        { glm::vec3(-68.0f, 12.0f, -11.0f), glm::vec3(-4.0f, 4.0f, 0.0f) },
+        { glm::vec3(-20.0f, 6.0f, 10.0f), glm::vec3(-4.0f, 4.0f, 0.0f) },
+        { glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f, 4.0f, 0.0f) },
+    }, false);
+
+    return paths;
+}
+
+void BenchmarkReport::BeginPath(const std::string& name)
+{
+    paths.push_back(PathSamples());
+    paths.back().name = name;
+    recording = false;
+}
+
+void BenchmarkReport::AddFrame(double frameMs, size_t drawCalls, size_t triangles)
+{
+    if (!recording || paths.empty())
+        return;
+    PathSamples& current = paths.back();
+    current.frameMs.push_back(frameMs);
+    current.drawCalls.push_back(drawCalls);
+    current.triangles.push_back(triangles);
+}
+
+void BenchmarkReport::Print() const
+{
+    for (const PathSamples& samples : paths) {
+        if (samples.frameMs.empty())
+            continue;
+        std::vector<double> sorted = samples.frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        char line[256];
+        std::snprintf(line, sizeof(line),
+            "Benchmark %-9s %4zu frames, frame ms avg %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f | draws %.1f | tris %.0f",
+            samples.name.c_str(), sorted.size(), average(sorted), percentile(sorted, 50.0), percentile(sorted, 95.0),
+            percentile(sorted, 99.0), sorted.back(), average(samples.drawCalls), average(samples.triangles));
+        std::cout << line << std::endl;
+    }
+}
+
+bool BenchmarkReport::Write(const std::string& path, const BenchmarkOptions& options, int width, int height,
+                            int framesPerPath, int warmupFrames, const std::string& renderer) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::BENCHMARK::CANNOT_WRITE_REPORT " << path << std::endl;
+        return false;
+    }
+
+    char number[64];
+    auto real = [&](double value) -> const char* {
+        std::snprintf(number, sizeof(number), "%.4f", value);
+        return number;
+    };
+
+    file << "{\n";
+    file << "  \"renderer\": " << jsonString(renderer) << ",\n";
+    file << "  \"width\": " << width << ", \"height\": " << height << ",\n";
+    file << "  \"framesPerPath\": " << framesPerPath << ", \"warmupFrames\": " << warmupFrames << ",\n";
+    file << "  \"cityCopies\": " << options.cityCopies << ", \"cars\": " << options.cars << ", \"lights\": " << options.lights << ",\n";
+    file << "  \"shading\": \"" << (options.deferred ? "deferred" : "forward") << "\",\n";
+    file << "  \"paths\": [";
+    for (size_t i = 0; i < paths.size(); i++) {
+        const PathSamples& samples = paths[i];
+        std::vector<double> frameMs = samples.frameMs;
+        std::vector<size_t> drawCalls = samples.drawCalls;
+        std::vector<size_t> triangles = samples.triangles;
+        std::sort(frameMs.begin(), frameMs.end());
+        std::sort(drawCalls.begin(), drawCalls.end());
+        std::sort(triangles.begin(), triangles.end());
+
+        file << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(samples.name) << ", \"frames\": " << frameMs.size();
+        if (!frameMs.empty()) {
+            file << ",\n     \"frameMs\": {\"min\": " << real(frameMs.front());
+            file << ", \"avg\": " << real(average(frameMs));
+            file << ", \"p50\": " << real(percentile(frameMs, 50.0));
+            file << ", \"p90\": " << real(percentile(frameMs, 90.0));
+            file << ", \"p95\": " << real(percentile(frameMs, 95.0));
+            file << ", \"p99\": " << real(percentile(frameMs, 99.0));
+            file << ", \"max\": " << real(frameMs.back()) << "},\n";
+            file << "     \"drawCalls\": {\"min\": " << drawCalls.front() << ", \"avg\": " << real(average(drawCalls))
+                 << ", \"max\": " << drawCalls.back() << "},\n";
+            file << "     \"triangles\": {\"min\": " << triangles.front() << ", \"avg\": " << real(average(triangles))
+                 << ", \"max\": " << triangles.back() << "}";
+        }
+        file << "}";
+    }
+    file << "\n  ]\n}\n";
+    std::cout << "Benchmark report written to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Scene scale and output of a --benchmark run (parsed together with HeadlessOptions).
+struct BenchmarkOptions {
+    bool enabled = false;
+    int cityCopies = 1;
+    int cars = 1;
+    int lights = 0;            // benchmark street lamps on top of the scene's own lights
+    bool deferred = false;
+    std::string reportPath = "benchmark.json";
+};
+
+struct CameraKey {
+    glm::vec3 position;
+    glm::vec3 target;
+};
+
+// Camera flight through evenly spaced keys, Catmull-Rom interpolated. t runs from 0 to 1;
+// a looped path joins its last key back to the first.
+class CameraPath {
+public:
+    CameraPath(const std::string& name, const std::vector<CameraKey>& keys, bool looped);
+
+    void Sample(float t, glm::vec3& position, glm::vec3& target) const;
+    const std::string& Name() const { return name; }
+
+private:
+    std::string name;
+    std::vector<CameraKey> keys;
+    bool looped;
+};
+
+// The fixed flights every benchmark run takes through the city, in order.
+std::vector<CameraPath> BenchmarkPaths();
+
+// Frame samples of a run, summarized per camera path. Frames added before EndWarmup are dropped.
+class BenchmarkReport {
+public:
+    void BeginPath(const std::string& name);
+    void EndWarmup() { recording = true; }
+    void AddFrame(double frameMs, size_t drawCalls, size_t triangles);
+
+    // One line per path on stdout.
+    void Print() const;
+    // Machine-readable report: run settings plus frame time percentiles, draw calls and triangles per path.
+    bool Write(const std::string& path, const BenchmarkOptions& options, int width, int height,
+               int framesPerPath, int warmupFrames, const std::string& renderer) const;
+
+private:
+    struct PathSamples {
+        std::string name;
+        std::vector<double> frameMs;
+        std::vector<size_t> drawCalls;
+        std::vector<size_t> triangles;
+    };
+    std::vector<PathSamples> paths;
+    bool recording = false;
+};
+
+#endif
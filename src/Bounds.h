@@ -0,0 +1,39 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extent() const { return (max - min) * 0.5f; }
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// Object-space bounds of a mesh, computed once at import and stored in the mesh cache.
+struct MeshBounds {
+    AABB box;
+    BoundingSphere sphere;
+};
+
+// Box around the transformed box (Arvo): centre moves with the matrix, extent goes through |M|.
+inline AABB TransformBox(const AABB& box, const glm::mat4& transform)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4(box.Center(), 1.0f));
+    glm::vec3 extent = box.Extent();
+    glm::vec3 radius(0.0f);
+    for (int column = 0; column < 3; column++)
+        radius += glm::abs(glm::vec3(transform[column])) * extent[column];
+    AABB result;
+    result.min = center - radius;
+    result.max = center + radius;
+    return result;
+}
+
+#endif
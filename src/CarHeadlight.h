@@ -2,6 +2,7 @@
 #define CAR_HEADLIGHT_H
 
 #include <glm/glm.hpp>
+#include "Light.h"
 
 class CarHeadlight {
 public:
@@ -15,6 +16,14 @@ public:
 
     CarHeadlight(glm::vec3 pos, glm::vec3 dir, glm::vec3 col, float intens, float cut, float outerCut, float rad)
         : position(pos), direction(glm::normalize(dir)), color(col), intensity(intens), cutoff(cut), outerCutoff(outerCut), radius(rad) {}
+
+    // Entry for the clustered light list.
+    Light ToLight() const
+    {
+        glm::vec3 premultiplied = color * intensity;
+        return { position, cutoff, direction, outerCutoff, premultiplied, radius, LightType::Headlight,
+            HeadlightRange(radius, Brightness(premultiplied)) };
+    }
 };
 
 #endif
@@ -0,0 +1,178 @@
+#include "Culling.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+
+Frustum Frustum::FromMatrix(const glm::mat4& clip)
+{
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+
+    const glm::vec4 planes[6] = {
+        row[3] + row[0], row[3] - row[0],   // left, right
+        row[3] + row[1], row[3] - row[1],   // bottom, top
+        row[3] + row[2], row[3] - row[2]    // near, far
+    };
+
+    Frustum frustum;
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 plane = i < 6 ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane /= length;
+        frustum.nx[i] = plane.x;
+        frustum.ny[i] = plane.y;
+        frustum.nz[i] = plane.z;
+        frustum.d[i] = plane.w;
+    }
+    return frustum;
+}
+
+Frustum::Result Frustum::TestBox(const AABB& box) const
+{
+    glm::vec3 c = box.Center();
+    glm::vec3 e = box.Extent();
+
+#ifdef CULLING_SSE
+    const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    int intersecting = 0;
+    for (int i = 0; i < 8; i += 4) {
+        __m128 px = _mm_load_ps(nx + i), py = _mm_load_ps(ny + i), pz = _mm_load_ps(nz + i);
+        // Signed distance of the centre and projected radius of the box onto each plane normal.
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+            _mm_add_ps(_mm_mul_ps(pz, cz), _mm_load_ps(d + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(px, absMask), ex),
+            _mm_mul_ps(_mm_and_ps(py, absMask), ey)), _mm_mul_ps(_mm_and_ps(pz, absMask), ez));
+
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps())))
+            return Outside;
+        intersecting |= _mm_movemask_ps(_mm_cmplt_ps(dist, radius));
+    }
+    return intersecting ? Intersecting : Inside;
+#else
+    Result result = Inside;
+    for (int i = 0; i < 6; i++) {
+        float dist = nx[i] * c.x + ny[i] * c.y + nz[i] * c.z + d[i];
+        float radius = std::fabs(nx[i]) * e.x + std::fabs(ny[i]) * e.y + std::fabs(nz[i]) * e.z;
+        if (dist + radius < 0.0f)
+            return Outside;
+        if (dist < radius)
+            result = Intersecting;
+    }
+    return result;
+#endif
+}
+
+bool Frustum::TestSphere(const BoundingSphere& sphere) const
+{
+    for (int i = 0; i < 6; i++)
+        if (nx[i] * sphere.center.x + ny[i] * sphere.center.y + nz[i] * sphere.center.z + d[i] < -sphere.radius)
+            return false;
+    return true;
+}
+
+void BoundsBVH::Build(const std::vector<AABB>& items)
+{
+    nodes.clear();
+    itemBoxes = items;
+    itemIndex.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+        itemIndex[i] = static_cast<unsigned int>(i);
+    if (items.empty())
+        return;
+
+    nodes.reserve(items.size() * 2);
+    Node root;
+    root.first = 0;
+    root.count = static_cast<uint32_t>(items.size());
+    root.left = 0;
+    nodes.push_back(root);
+    subdivide(0);
+}
+
+void BoundsBVH::subdivide(uint32_t nodeIndex)
+{
+    uint32_t first = nodes[nodeIndex].first;
+    uint32_t count = nodes[nodeIndex].count;
+
+    AABB box = itemBoxes[itemIndex[first]];
+    glm::vec3 centroidMin = box.Center(), centroidMax = box.Center();
+    for (uint32_t i = first; i < first + count; i++) {
+        const AABB& item = itemBoxes[itemIndex[i]];
+        box.min = glm::min(box.min, item.min);
+        box.max = glm::max(box.max, item.max);
+        centroidMin = glm::min(centroidMin, item.Center());
+        centroidMax = glm::max(centroidMax, item.Center());
+    }
+    nodes[nodeIndex].box = box;
+    if (count <= LEAF_SIZE)
+        return;
+
+    glm::vec3 spread = centroidMax - centroidMin;
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    uint32_t half = count / 2;
+    std::nth_element(itemIndex.begin() + first, itemIndex.begin() + first + half, itemIndex.begin() + first + count,
+        [&](unsigned int a, unsigned int b) {
+            float ca = itemBoxes[a].Center()[axis], cb = itemBoxes[b].Center()[axis];
+            return ca != cb ? ca < cb : a < b;
+        });
+
+    uint32_t left = static_cast<uint32_t>(nodes.size());
+    Node child;
+    child.left = 0;
+    child.first = first;
+    child.count = half;
+    nodes.push_back(child);
+    child.first = first + half;
+    child.count = count - half;
+    nodes.push_back(child);
+    nodes[nodeIndex].left = left;
+
+    subdivide(left);
+    subdivide(left + 1);
+}
+
+void BoundsBVH::Query(const Frustum& frustum, std::vector<unsigned int>& visible, CullStats& stats) const
+{
+    if (nodes.empty())
+        return;
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        Frustum::Result result = frustum.TestBox(node.box);
+        if (result == Frustum::Outside) {
+            stats.culled += node.count;
+            continue;
+        }
+        if (result == Frustum::Inside) {
+            visible.insert(visible.end(), itemIndex.begin() + node.first, itemIndex.begin() + node.first + node.count);
+            stats.drawn += node.count;
+            continue;
+        }
+        if (node.left) {
+            stack[top++] = node.left + 1;
+            stack[top++] = node.left;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            stats.tested++;
+            if (frustum.TestBox(itemBoxes[itemIndex[i]]) == Frustum::Outside) {
+                stats.culled++;
+                continue;
+            }
+            visible.push_back(itemIndex[i]);
+            stats.drawn++;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// Per-frame culling counters. tested counts individual mesh box tests; meshes accepted or
+// rejected by a whole BVH node are counted in drawn/culled without being tested.
+struct CullStats {
+    size_t tested = 0;
+    size_t culled = 0;
+    size_t drawn = 0;
+};
+
+// Six planes extracted from a clip matrix (Gribb/Hartmann). Built from projection * view * model
+// the planes live in model space, so object-space bounds can be tested without transforming them.
+class Frustum {
+public:
+    enum Result { Outside, Intersecting, Inside };
+
+    static Frustum FromMatrix(const glm::mat4& clip);
+
+    // SSE on x86, 4 planes per step; scalar elsewhere.
+    Result TestBox(const AABB& box) const;
+    bool TestSphere(const BoundingSphere& sphere) const;
+
+private:
+    // Structure-of-arrays, padded to 8 with planes that accept everything.
+    alignas(16) float nx[8];
+    alignas(16) float ny[8];
+    alignas(16) float nz[8];
+    alignas(16) float d[8];
+};
+
+// Bounding volume hierarchy over a fixed set of boxes (median split on the longest centroid axis).
+// Each node covers a contiguous range of item indices, so whole subtrees are accepted or rejected at once.
+class BoundsBVH {
+public:
+    void Build(const std::vector<AABB>& items);
+    // Appends the visible item indices to visible.
+    void Query(const Frustum& frustum, std::vector<unsigned int>& visible, CullStats& stats) const;
+    size_t NodeCount() const { return nodes.size(); }
+    // Box around every item; all zero when empty.
+    AABB Bounds() const { return nodes.empty() ? AABB{ glm::vec3(0.0f), glm::vec3(0.0f) } : nodes[0].box; }
+
+private:
+    struct Node {
+        AABB box;
+        uint32_t first;
+        uint32_t count;
+        uint32_t left;   // right child is left + 1; 0 = leaf
+    };
+    static const uint32_t LEAF_SIZE = 4;
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> itemIndex;
+    std::vector<AABB> itemBoxes;
+
+    void subdivide(uint32_t node);
+};
+
+#endif
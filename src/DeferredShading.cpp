@@ -0,0 +1,121 @@
+#include "DeferredShading.h"
+#include <iostream>
+
+DeferredShading::DeferredShading()
+{
+    // The full-screen triangle is generated from gl_VertexID, but core profile still wants a VAO bound.
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+DeferredShading::~DeferredShading()
+{
+    release();
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void DeferredShading::release()
+{
+    if (!FBO)
+        return;
+    GLuint textures[3] = { albedoTexture, normalTexture, depthTexture };
+    glDeleteTextures(3, textures);
+    glDeleteFramebuffers(1, &FBO);
+    FBO = albedoTexture = normalTexture = depthTexture = 0;
+    width = height = 0;
+}
+
+static unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+bool DeferredShading::Resize(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+    if (FBO && width == this->width && height == this->height)
+        return true;
+
+    release();
+    glActiveTexture(GL_TEXTURE0);
+    albedoTexture = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    normalTexture = createTarget(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height);
+    depthTexture = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previousFramebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+    this->width = width;
+    this->height = height;
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::FRAMEBUFFER::G-buffer is not complete (0x" << std::hex << status << std::dec << ")" << std::endl;
+        release();
+        return false;
+    }
+    return true;
+}
+
+void DeferredShading::BeginGeometry()
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outputFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Alpha carries roughness here, so nothing may blend into the G-buffer.
+    glDisable(GL_BLEND);
+}
+
+void DeferredShading::Attach(Shader& lightingShader) const
+{
+    lightingShader.use();
+    lightingShader.setInt("gAlbedo", ALBEDO_UNIT);
+    lightingShader.setInt("gNormal", NORMAL_UNIT);
+    lightingShader.setInt("gDepth", DEPTH_UNIT);
+}
+
+void DeferredShading::Light(Shader& lightingShader, const glm::mat4& inverseViewProjection)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+    glViewport(0, 0, width, height);
+
+    lightingShader.use();
+    lightingShader.setMat4("inverseViewProjection", inverseViewProjection);
+    const unsigned int textures[3] = { albedoTexture, normalTexture, depthTexture };
+    const GLuint units[3] = { ALBEDO_UNIT, NORMAL_UNIT, DEPTH_UNIT };
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+
+    // Every pixel passes and takes the G-buffer depth, so transparent draws test against the scene.
+    glDepthFunc(GL_ALWAYS);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS);
+
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,48 @@
+#ifndef DEFERRED_SHADING_H
+#define DEFERRED_SHADING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include "Shader.h"
+
+// Deferred alternative to the forward path. The opaque layer is rasterized once into a G-buffer
+// (albedo + roughness, normal, depth) with gbuffer_fragment.glsl, then one full-screen pass
+// (deferred_lighting.glsl) shades every covered pixel exactly once, so overdraw only costs the
+// cheap geometry pass. Transparent draws stay forward on top of the result.
+class DeferredShading {
+public:
+    // Units the lighting pass samples the G-buffer from; the pass binds no material textures.
+    static const GLuint ALBEDO_UNIT = 0;
+    static const GLuint NORMAL_UNIT = 1;
+    static const GLuint DEPTH_UNIT = 2;
+
+    DeferredShading();
+    ~DeferredShading();
+    DeferredShading(const DeferredShading&) = delete;
+    DeferredShading& operator=(const DeferredShading&) = delete;
+
+    // (Re)creates the G-buffer when the framebuffer size changed; false if it is unusable.
+    bool Resize(int width, int height);
+    // Binds and clears the G-buffer; opaque draws with the geometry program follow.
+    void BeginGeometry();
+    // Shades the G-buffer into the framebuffer that was bound before BeginGeometry (the window's, or
+    // an OffscreenTarget) and writes its depth there, so transparent draws can follow forward. That
+    // framebuffer must already be cleared to the sky color.
+    void Light(Shader& lightingShader, const glm::mat4& inverseViewProjection);
+    // Points the lighting program's G-buffer samplers at their units.
+    void Attach(Shader& lightingShader) const;
+
+    size_t GpuBytes() const { return static_cast<size_t>(width) * height * (4 + 8 + 4); }
+
+private:
+    int width = 0, height = 0;
+    unsigned int FBO = 0;
+    unsigned int albedoTexture = 0, normalTexture = 0, depthTexture = 0;
+    unsigned int emptyVAO = 0;
+    GLint outputFramebuffer = 0;
+
+    void release();
+};
+
+#endif
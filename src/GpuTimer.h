@@ -0,0 +1,60 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of the commands between Begin() and End(), measured with GL_TIME_ELAPSED queries.
+// Results are only read once the driver reports them available, so timing never stalls; for
+// spans that do not run every frame, Poll() picks up the result later.
+class GpuTimer {
+public:
+    static const int QUERY_COUNT = 4;
+
+    GpuTimer() { glGenQueries(QUERY_COUNT, queries); }
+    ~GpuTimer() { glDeleteQueries(QUERY_COUNT, queries); }
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void Begin()
+    {
+        // All queries in flight: the oldest result is given up rather than waited for.
+        if (pending == QUERY_COUNT)
+            pending--;
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    void End()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        next = (next + 1) % QUERY_COUNT;
+        pending++;
+        Poll();
+    }
+
+    // Reads every finished query, oldest first.
+    void Poll()
+    {
+        while (pending > 0) {
+            GLuint query = queries[(next - pending + QUERY_COUNT) % QUERY_COUNT];
+            GLuint available = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            lastMs = elapsed / 1.0e6;
+            pending--;
+        }
+    }
+
+    // Latest finished measurement in milliseconds, 0 until one is available.
+    double LastMs() const { return lastMs; }
+
+private:
+    GLuint queries[QUERY_COUNT];
+    int next = 0;
+    int pending = 0;
+    double lastMs = 0.0;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "Headless.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace {
+
+bool parseCount(const char* argument, const char* value, int minimum, int& count)
+{
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < minimum || parsed > 1000000) {
+        std::cout << "ERROR::ARGUMENTS::" << argument << " expects a count of at least " << minimum << ", got " << value << std::endl;
+        return false;
+    }
+    count = static_cast<int>(parsed);
+    return true;
+}
+
+}
+
+bool HeadlessOptions::Parse(int argc, char** argv, HeadlessOptions& options)
+{
+    static const char* const valued[] = { "--size", "--frames", "--output", "--city-copies", "--cars", "--lights", "--report" };
+    bool framesGiven = false, outputGiven = false;
+    for (int i = 1; i < argc; i++) {
+        const char* argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(argument, "--headless") == 0) {
+            options.enabled = true;
+            continue;
+        }
+        if (std::strcmp(argument, "--benchmark") == 0) {
+            options.enabled = true;
+            options.benchmark.enabled = true;
+            continue;
+        }
+        if (std::strcmp(argument, "--deferred") == 0) {
+            options.benchmark.deferred = true;
+            continue;
+        }
+        if (std::strcmp(argument, "--tangent-benchmark") == 0) {
+            options.tangentBenchmark = true;
+            continue;
+        }
+        if (std::none_of(std::begin(valued), std::end(valued), [&](const char* name) { return std::strcmp(argument, name) == 0; })) {
+            std::cout << "ERROR::ARGUMENTS::Unknown argument " << argument << std::endl;
+            return false;
+        }
+        if (!value) {
+            std::cout << "ERROR::ARGUMENTS::" << argument << " needs a value" << std::endl;
+            return false;
+        }
+        bool valid = true;
+        if (std::strcmp(argument, "--size") == 0) {
+            if (std::sscanf(value, "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0) {
+                std::cout << "ERROR::ARGUMENTS::--size expects WIDTHxHEIGHT, got " << value << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(argument, "--frames") == 0) {
+            valid = parseCount(argument, value, 1, options.frames);
+            framesGiven = true;
+        }
+        else if (std::strcmp(argument, "--output") == 0) {
+            options.outputDirectory = value;
+            outputGiven = true;
+        }
+        else if (std::strcmp(argument, "--city-copies") == 0)
+            valid = parseCount(argument, value, 1, options.benchmark.cityCopies);
+        else if (std::strcmp(argument, "--cars") == 0)
+            valid = parseCount(argument, value, 1, options.benchmark.cars);
+        else if (std::strcmp(argument, "--lights") == 0)
+            valid = parseCount(argument, value, 0, options.benchmark.lights);
+        else
+            options.benchmark.reportPath = value;
+        if (!valid)
+            return false;
+        i++;
+    }
+
+    if (options.benchmark.enabled) {
+        if (!framesGiven)
+            options.frames = 240;
+        options.saveFrames = outputGiven;
+    }
+    return true;
+}
+
+OffscreenTarget::OffscreenTarget(int width, int height)
+    : width(width), height(height)
+{
+    glGenRenderbuffers(1, &colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete)
+        std::cout << "ERROR::FRAMEBUFFER::Offscreen target " << width << "x" << height << " is not complete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+    glDeleteFramebuffers(1, &FBO);
+    GLuint renderbuffers[2] = { colorRBO, depthRBO };
+    glDeleteRenderbuffers(2, renderbuffers);
+}
+
+void OffscreenTarget::Bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+}
+
+bool OffscreenTarget::SavePng(const std::string& path) const
+{
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // GL rows start at the bottom.
+    stbi_flip_vertically_on_write(1);
+    if (!stbi_write_png(path.c_str(), width, height, 3, pixels.data(), width * 3)) {
+        std::cout << "ERROR::HEADLESS::Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
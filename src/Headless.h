@@ -0,0 +1,53 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+#include <string>
+#include "Benchmark.h"
+
+// Command line of a headless run: --headless [--size WIDTHxHEIGHT] [--frames N] [--output DIR].
+// --benchmark [--city-copies N] [--cars N] [--lights N] [--deferred] [--report FILE] implies
+// --headless and flies the BenchmarkPaths instead; --frames is then per path (default 240) and
+// frames are only saved when --output is given. --tangent-benchmark times the tangent kernels on
+// the sphere model and exits without opening a window.
+struct HeadlessOptions {
+    bool enabled = false;
+    int width = 1300;
+    int height = 900;
+    int frames = 1;
+    std::string outputDirectory = "frames";
+    bool saveFrames = true;
+    BenchmarkOptions benchmark;
+    bool tangentBenchmark = false;
+
+    // Prints the problem and returns false on an unknown or malformed argument.
+    static bool Parse(int argc, char** argv, HeadlessOptions& options);
+};
+
+// Color + depth framebuffer that stands in for the window's framebuffer in a headless run.
+// Passes that render elsewhere (shadow maps, the G-buffer) return to whichever framebuffer was
+// bound, so binding this once per frame is enough.
+class OffscreenTarget {
+public:
+    OffscreenTarget(int width, int height);
+    ~OffscreenTarget();
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    bool IsComplete() const { return complete; }
+    // Binds the framebuffer and sets the viewport to cover it.
+    void Bind() const;
+    // Reads the color buffer back and writes it as an RGB PNG, top row first.
+    bool SavePng(const std::string& path) const;
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+private:
+    int width, height;
+    unsigned int FBO = 0;
+    unsigned int colorRBO = 0, depthRBO = 0;
+    bool complete = false;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "JobPool.h"
+#include <algorithm>
+
+JobPool& JobPool::Get()
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    static JobPool pool(cores > 1 ? cores - 1 : 0);
+    return pool;
+}
+
+JobPool::JobPool(unsigned int threadCount)
+{
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&JobPool::workerLoop, this, i + 1);
+}
+
+JobPool::~JobPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAdded.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void JobPool::ParallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+    if (workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++)
+            body(i);
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->body = &body;
+    job->count = count;
+    size_t participants = workers.size() + 1;
+    for (size_t p = 0; p < participants; p++)
+        job->slices.push_back({ count * p / participants, count * (p + 1) / participants });
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    jobAdded.notify_all();
+
+    work(*job, 0);
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->allDone.wait(lock, [&] { return job->finished == job->count; });
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = std::find(jobs.begin(), jobs.end(), job);
+    if (found != jobs.end())
+        jobs.erase(found);
+}
+
+void JobPool::work(Job& job, unsigned int participant)
+{
+    for (;;) {
+        size_t item;
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            Slice& own = job.slices[participant];
+            if (own.begin == own.end) {
+                Slice* victim = nullptr;
+                for (Slice& slice : job.slices) {
+                    if (slice.end - slice.begin > (victim ? victim->end - victim->begin : 0))
+                        victim = &slice;
+                }
+                if (!victim)
+                    return;
+                size_t take = (victim->end - victim->begin + 1) / 2;
+                own.begin = victim->end - take;
+                own.end = victim->end;
+                victim->end -= take;
+            }
+            item = own.begin++;
+        }
+
+        (*job.body)(item);
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (++job.finished == job.count)
+            job.allDone.notify_all();
+    }
+}
+
+void JobPool::workerLoop(unsigned int participant)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping)
+            return;
+        // The oldest call first; once it has nothing left to take, it leaves the list so the
+        // worker moves on while its last items finish elsewhere.
+        std::shared_ptr<Job> job = jobs.front();
+        lock.unlock();
+        work(*job, participant);
+        lock.lock();
+        if (!jobs.empty() && jobs.front() == job)
+            jobs.pop_front();
+    }
+}
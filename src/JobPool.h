@@ -0,0 +1,57 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for loops over independent items of uneven cost (one mesh each, say).
+// ParallelFor deals the index range out evenly, one slice per participant; a participant that
+// runs dry steals the back half of the largest slice left. The calling thread takes part too,
+// and several threads may run ParallelFor at once (the model loader's workers do).
+class JobPool {
+public:
+    static JobPool& Get();
+
+    explicit JobPool(unsigned int threadCount);
+    ~JobPool();
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    // Calls body(i) once for every i in [0, count) and returns when all calls have.
+    // Items finish in no particular order, so body should write its result to slot i.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+    unsigned int ThreadCount() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    struct Slice {
+        size_t begin, end;
+    };
+
+    // One ParallelFor call. Participant 0 is the caller, worker w is participant w + 1.
+    struct Job {
+        const std::function<void(size_t)>* body;
+        size_t count;
+        std::mutex mutex;
+        std::condition_variable allDone;
+        std::vector<Slice> slices;
+        size_t finished = 0;
+    };
+
+    void workerLoop(unsigned int participant);
+    // Runs items of job until nothing is left to take.
+    static void work(Job& job, unsigned int participant);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::deque<std::shared_ptr<Job>> jobs;    // running calls, oldest first
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Falloff a light is shaded with: CalculateStreetLight or CalculateHeadlight in clustered_lights.glsl.
+enum class LightType : int {
+    StreetLamp = 0,
+    Headlight = 1
+};
+
+// Below this the contribution of a light is dropped; it decides how far a light is binned.
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// One spot light of the clustered light list. color is already multiplied by the intensity.
+struct Light {
+    glm::vec3 position;
+    float cutoff;        // cos of the inner cone angle
+    glm::vec3 direction;
+    float outerCutoff;   // cos of the outer cone angle
+    glm::vec3 color;
+    float radius;        // falloff parameter of the light type
+    LightType type;
+    float range;         // distance where the falloff times the brightest channel reaches LIGHT_CUTOFF
+};
+
+// 1 / (1 + r d + r d^2) reaches LIGHT_CUTOFF / brightness.
+inline float StreetLampRange(float radius, float brightness)
+{
+    float limit = brightness / LIGHT_CUTOFF - 1.0f;
+    if (limit <= 0.0f || radius <= 0.0f)
+        return 0.0f;
+    return (-radius + std::sqrt(radius * radius + 4.0f * radius * limit)) / (2.0f * radius);
+}
+
+// exp(-(d / r)^2.5) times the specular and halo boost (at most 2.2) reaches LIGHT_CUTOFF / brightness.
+inline float HeadlightRange(float radius, float brightness)
+{
+    float limit = std::log(2.2f * brightness / LIGHT_CUTOFF);
+    if (limit <= 0.0f)
+        return 0.0f;
+    return radius * std::pow(limit, 0.4f);
+}
+
+inline float Brightness(const glm::vec3& color)
+{
+    return std::max(color.r, std::max(color.g, color.b));
+}
+
+#endif
@@ -0,0 +1,296 @@
+#include "LightClusters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE 1
+#include <emmintrin.h>
+#endif
+
+LightClusters::LightClusters(unsigned int threadCount)
+{
+    size_t size = CLUSTER_COUNT;
+    minX.resize(size); minY.resize(size); minZ.resize(size);
+    maxX.resize(size); maxY.resize(size); maxZ.resize(size);
+    clusterRanges.assign(CLUSTER_COUNT * 2, 0);
+    pairs.resize(threadCount + 1);
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&LightClusters::workerLoop, this, i + 1);
+}
+
+LightClusters::~LightClusters()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startWork.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    if (lightTexture) {
+        GLuint textures[3] = { lightTexture, clusterTexture, indexTexture };
+        GLuint buffers[3] = { lightVBO, clusterVBO, indexVBO };
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+}
+
+void LightClusters::SetProjection(const glm::mat4& projection, float near, float far)
+{
+    projX = projection[0][0];
+    projY = projection[1][1];
+    nearDepth = near;
+    farDepth = far;
+    float logRatio = std::log(far / near);
+    sliceScale = GRID_Z / logRatio;
+    sliceBias = -static_cast<float>(GRID_Z) * std::log(near) / logRatio;
+
+    // A cluster is the frustum piece between two tile edges and two slice depths; its view-space
+    // box spans the tile corners at both depths.
+    for (unsigned int z = 0; z < GRID_Z; z++) {
+        float d0 = near * std::pow(far / near, float(z) / GRID_Z);
+        float d1 = near * std::pow(far / near, float(z + 1) / GRID_Z);
+        for (unsigned int y = 0; y < GRID_Y; y++) {
+            float ny0 = -1.0f + 2.0f * y / GRID_Y, ny1 = -1.0f + 2.0f * (y + 1) / GRID_Y;
+            for (unsigned int x = 0; x < GRID_X; x++) {
+                float nx0 = -1.0f + 2.0f * x / GRID_X, nx1 = -1.0f + 2.0f * (x + 1) / GRID_X;
+                size_t cluster = (z * GRID_Y + y) * GRID_X + x;
+                minX[cluster] = std::min(nx0 * d0, nx0 * d1) / projX;
+                maxX[cluster] = std::max(nx1 * d0, nx1 * d1) / projX;
+                minY[cluster] = std::min(ny0 * d0, ny0 * d1) / projY;
+                maxY[cluster] = std::max(ny1 * d0, ny1 * d1) / projY;
+                minZ[cluster] = -d1;
+                maxZ[cluster] = -d0;
+            }
+        }
+    }
+}
+
+int LightClusters::sliceOf(float depth) const
+{
+    int slice = static_cast<int>(std::floor(std::log(depth) * sliceScale + sliceBias));
+    return std::min(std::max(slice, 0), static_cast<int>(GRID_Z) - 1);
+}
+
+void LightClusters::Build(const std::vector<Light>& lights, const glm::mat4& view)
+{
+    auto start = std::chrono::steady_clock::now();
+    sourceLights = &lights;
+    lightCount = std::min<size_t>(lights.size(), MAX_LIGHTS);
+    bounds.resize(lightCount);
+
+    for (size_t i = 0; i < lightCount; i++) {
+        const Light& light = lights[i];
+        LightBounds& b = bounds[i];
+        b.z0 = 0;
+        b.z1 = -1;
+
+        // Street lamps have an ambient term all around; headlights are dark outside the outer cone,
+        // so they get the cone's bounding sphere instead.
+        glm::vec3 center = light.position;
+        float radius = light.range;
+        float cosOuter = std::min(std::max(light.outerCutoff, -1.0f), 1.0f);
+        if (light.type == LightType::Headlight && cosOuter > 0.0f) {
+            if (cosOuter >= 0.70710678f) {
+                radius = light.range / (2.0f * cosOuter);
+                center = light.position + light.direction * radius;
+            }
+            else {
+                center = light.position + light.direction * (light.range * cosOuter);
+                radius = light.range * std::sqrt(1.0f - cosOuter * cosOuter);
+            }
+        }
+        if (!(radius > 0.0f))
+            continue;
+
+        b.center = glm::vec3(view * glm::vec4(center, 1.0f));
+        b.radius = radius;
+        float nearest = -b.center.z - radius, farthest = -b.center.z + radius;
+        if (farthest < nearDepth || nearest > farDepth)
+            continue;
+
+        // Screen rectangle of the sphere's view-space box, conservative over its depth range.
+        float zn = std::max(nearest, nearDepth), zf = std::max(farthest, nearDepth);
+        auto tileRange = [&](float c, float scale, unsigned int tiles, int& first, int& last) {
+            float lo = c - radius, hi = c + radius;
+            float ndcMin = scale * (lo < 0.0f ? lo / zn : lo / zf);
+            float ndcMax = scale * (hi > 0.0f ? hi / zn : hi / zf);
+            if (ndcMax < -1.0f || ndcMin > 1.0f)
+                return false;
+            first = std::max(0, static_cast<int>(std::floor((ndcMin + 1.0f) * 0.5f * tiles)));
+            last = std::min(static_cast<int>(tiles) - 1, static_cast<int>(std::floor((ndcMax + 1.0f) * 0.5f * tiles)));
+            return true;
+        };
+        if (!tileRange(b.center.x, projX, GRID_X, b.x0, b.x1) || !tileRange(b.center.y, projY, GRID_Y, b.y0, b.y1))
+            continue;
+        b.z0 = sliceOf(zn);
+        b.z1 = sliceOf(std::min(zf, farDepth));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        running = static_cast<unsigned int>(workers.size());
+    }
+    startWork.notify_all();
+    binSlices(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this] { return running == 0; });
+    }
+
+    // Participants own ascending slice ranges and emit pairs in light order, so a counting sort
+    // keeps every cluster's lights ascending and the result independent of the thread count.
+    std::fill(clusterRanges.begin(), clusterRanges.end(), 0);
+    for (const std::vector<uint32_t>& list : pairs)
+        for (uint32_t pair : list)
+            clusterRanges[(pair >> 16) * 2 + 1]++;
+    stats = Stats();
+    uint32_t offset = 0;
+    for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+        uint32_t count = clusterRanges[cluster * 2 + 1];
+        clusterRanges[cluster * 2] = offset;
+        offset += count;
+        if (count)
+            stats.occupiedClusters++;
+        stats.maxPerCluster = std::max<size_t>(stats.maxPerCluster, count);
+    }
+    lightIndices.resize(offset);
+    std::vector<uint32_t> cursor(CLUSTER_COUNT);
+    for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        cursor[cluster] = clusterRanges[cluster * 2];
+    std::vector<unsigned char> binned(lightCount, 0);
+    for (const std::vector<uint32_t>& list : pairs) {
+        for (uint32_t pair : list) {
+            lightIndices[cursor[pair >> 16]++] = static_cast<uint16_t>(pair & 0xFFFF);
+            binned[pair & 0xFFFF] = 1;
+        }
+    }
+
+    stats.lights = lightCount;
+    stats.binnedLights = std::count(binned.begin(), binned.end(), 1);
+    stats.references = lightIndices.size();
+    stats.binMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightClusters::binSlices(unsigned int participant)
+{
+    unsigned int participants = static_cast<unsigned int>(workers.size()) + 1;
+    int firstSlice = static_cast<int>(GRID_Z * participant / participants);
+    int endSlice = static_cast<int>(GRID_Z * (participant + 1) / participants);
+    std::vector<uint32_t>& out = pairs[participant];
+    out.clear();
+
+    for (size_t i = 0; i < lightCount; i++) {
+        const LightBounds& b = bounds[i];
+        int z0 = std::max(b.z0, firstSlice), z1 = std::min(b.z1, endSlice - 1);
+        float r2 = b.radius * b.radius;
+        for (int z = z0; z <= z1; z++) {
+            for (int y = b.y0; y <= b.y1; y++) {
+                size_t row = (size_t(z) * GRID_Y + y) * GRID_X;
+#ifdef LIGHT_CLUSTERS_SSE
+                // Sphere against four cluster boxes at a time: squared distance from the centre to each box.
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 cx = _mm_set1_ps(b.center.x), cy = _mm_set1_ps(b.center.y), cz = _mm_set1_ps(b.center.z);
+                const __m128 radiusSq = _mm_set1_ps(r2);
+                for (int x = b.x0 & ~3; x <= b.x1; x += 4) {
+                    size_t at = row + x;
+                    __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[at]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&maxX[at]))));
+                    __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[at]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&maxY[at]))));
+                    __m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[at]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&maxZ[at]))));
+                    __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                    int hits = _mm_movemask_ps(_mm_cmple_ps(distSq, radiusSq));
+                    for (int lane = 0; hits; lane++, hits >>= 1) {
+                        int cell = x + lane;
+                        if ((hits & 1) && cell >= b.x0 && cell <= b.x1)
+                            out.push_back(static_cast<uint32_t>((row + cell) << 16 | i));
+                    }
+                }
+#else
+                for (int x = b.x0; x <= b.x1; x++) {
+                    size_t at = row + x;
+                    float dx = std::max(0.0f, std::max(minX[at] - b.center.x, b.center.x - maxX[at]));
+                    float dy = std::max(0.0f, std::max(minY[at] - b.center.y, b.center.y - maxY[at]));
+                    float dz = std::max(0.0f, std::max(minZ[at] - b.center.z, b.center.z - maxZ[at]));
+                    if (dx * dx + dy * dy + dz * dz <= r2)
+                        out.push_back(static_cast<uint32_t>(at << 16 | i));
+                }
+#endif
+            }
+        }
+    }
+}
+
+void LightClusters::workerLoop(unsigned int participant)
+{
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        startWork.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        lock.unlock();
+        binSlices(participant);
+        lock.lock();
+        if (--running == 0)
+            workDone.notify_one();
+    }
+}
+
+void LightClusters::Upload()
+{
+    if (!lightTexture) {
+        glGenBuffers(1, &lightVBO);
+        glGenBuffers(1, &clusterVBO);
+        glGenBuffers(1, &indexVBO);
+        glGenTextures(1, &lightTexture);
+        glGenTextures(1, &clusterTexture);
+        glGenTextures(1, &indexTexture);
+    }
+
+    // Four texels per light: position + cutoff, direction + outer cutoff, color + radius, type + range.
+    std::vector<glm::vec4> texels(std::max<size_t>(lightCount, 1) * 4, glm::vec4(0.0f));
+    for (size_t i = 0; i < lightCount; i++) {
+        const Light& light = (*sourceLights)[i];
+        texels[i * 4 + 0] = glm::vec4(light.position, light.cutoff);
+        texels[i * 4 + 1] = glm::vec4(light.direction, light.outerCutoff);
+        texels[i * 4 + 2] = glm::vec4(light.color, light.radius);
+        texels[i * 4 + 3] = glm::vec4(static_cast<float>(light.type), light.range, 0.0f, 0.0f);
+    }
+    uint16_t noIndex = 0;
+    const void* indexData = lightIndices.empty() ? static_cast<const void*>(&noIndex) : lightIndices.data();
+    size_t indexBytes = std::max<size_t>(lightIndices.size(), 1) * sizeof(uint16_t);
+
+    struct Target { unsigned int buffer, texture; GLenum format; GLuint unit; const void* data; size_t bytes; };
+    const Target targets[3] = {
+        { lightVBO, lightTexture, GL_RGBA32F, LIGHT_UNIT, texels.data(), texels.size() * sizeof(glm::vec4) },
+        { clusterVBO, clusterTexture, GL_RG32UI, CLUSTER_UNIT, clusterRanges.data(), clusterRanges.size() * sizeof(uint32_t) },
+        { indexVBO, indexTexture, GL_R16UI, INDEX_UNIT, indexData, indexBytes }
+    };
+    for (const Target& target : targets) {
+        glBindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+        glBufferData(GL_TEXTURE_BUFFER, target.bytes, target.data, GL_STREAM_DRAW);
+        glActiveTexture(GL_TEXTURE0 + target.unit);
+        glBindTexture(GL_TEXTURE_BUFFER, target.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, target.format, target.buffer);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::Attach(Shader& shader) const
+{
+    shader.use();
+    shader.setInt("lightBuffer", LIGHT_UNIT);
+    shader.setInt("clusterBuffer", CLUSTER_UNIT);
+    shader.setInt("lightIndexBuffer", INDEX_UNIT);
+}
+
+void LightClusters::FillUniforms(LightUniforms& uniforms, float viewportWidth, float viewportHeight) const
+{
+    uniforms.clusterGrid = glm::uvec4(GRID_X, GRID_Y, GRID_Z, static_cast<unsigned int>(lightCount));
+    uniforms.clusterParams = glm::vec4(sliceScale, sliceBias, 1.0f / viewportWidth, 1.0f / viewportHeight);
+}
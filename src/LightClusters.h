@@ -0,0 +1,104 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Light.h"
+#include "SceneUniforms.h"
+#include "Shader.h"
+
+// Clustered forward lighting. The view frustum is split into GRID_X x GRID_Y screen tiles and
+// GRID_Z exponentially spaced depth slices; every light's bounding sphere is tested against the
+// clusters it can reach (SSE, depth slices spread over a small thread pool) and the resulting
+// per-cluster index lists go to the GPU as buffer textures. clustered_lights.glsl then shades a
+// fragment with the lights of its own cluster only.
+class LightClusters {
+public:
+    static const unsigned int GRID_X = 16;
+    static const unsigned int GRID_Y = 9;
+    static const unsigned int GRID_Z = 24;
+    static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    static const unsigned int MAX_LIGHTS = 65536;   // 16-bit light indices
+
+    // Units of lightBuffer, clusterBuffer and lightIndexBuffer; above anything a material binds.
+    static const GLuint LIGHT_UNIT = 8;
+    static const GLuint CLUSTER_UNIT = 9;
+    static const GLuint INDEX_UNIT = 10;
+
+    struct Stats {
+        size_t lights = 0;
+        size_t binnedLights = 0;       // lights touching at least one cluster
+        size_t references = 0;         // entries in the index list
+        size_t occupiedClusters = 0;
+        size_t maxPerCluster = 0;
+        double binMs = 0.0;
+    };
+
+    // threadCount helpers bin alongside the calling thread; 0 bins on the caller alone.
+    explicit LightClusters(unsigned int threadCount);
+    ~LightClusters();
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // Symmetric perspective projection. Slices cover [near, far]; fragments past far use the last one.
+    void SetProjection(const glm::mat4& projection, float near, float far);
+    // CPU only: bins the world-space lights for this view. At most MAX_LIGHTS are used.
+    void Build(const std::vector<Light>& lights, const glm::mat4& view);
+    // GL: uploads the lights and cluster lists of the last Build and binds the buffer textures.
+    void Upload();
+    // Points the program's cluster samplers at their units.
+    void Attach(Shader& shader) const;
+    void FillUniforms(LightUniforms& uniforms, float viewportWidth, float viewportHeight) const;
+
+    const Stats& GetStats() const { return stats; }
+    // (first index, count) per cluster, x fastest, then y, then depth slice.
+    const std::vector<uint32_t>& GetClusterRanges() const { return clusterRanges; }
+    const std::vector<uint16_t>& GetLightIndices() const { return lightIndices; }
+    unsigned int ThreadCount() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    // A light's view-space bounding sphere and the cluster box it can touch.
+    struct LightBounds {
+        glm::vec3 center;
+        float radius;
+        int x0, x1, y0, y1, z0, z1;
+    };
+
+    // View-space cluster boxes as structure of arrays; a row of GRID_X clusters is contiguous.
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    float projX = 1.0f, projY = 1.0f;
+    float nearDepth = 0.1f, farDepth = 100.0f;
+    float sliceScale = 1.0f, sliceBias = 0.0f;
+
+    const std::vector<Light>* sourceLights = nullptr;
+    size_t lightCount = 0;
+    std::vector<LightBounds> bounds;
+    // Per participant: packed (cluster << 16 | light) pairs for its depth slices, in light order.
+    std::vector<std::vector<uint32_t>> pairs;
+    std::vector<uint32_t> clusterRanges;
+    std::vector<uint16_t> lightIndices;
+    Stats stats;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startWork;
+    std::condition_variable workDone;
+    unsigned int generation = 0;
+    unsigned int running = 0;
+    bool stopping = false;
+
+    unsigned int lightTexture = 0, clusterTexture = 0, indexTexture = 0;
+    unsigned int lightVBO = 0, clusterVBO = 0, indexVBO = 0;
+
+    int sliceOf(float depth) const;
+    void binSlices(unsigned int participant);
+    void workerLoop(unsigned int participant);
+};
+
+#endif
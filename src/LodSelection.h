@@ -0,0 +1,32 @@
+#ifndef LOD_SELECTION_H
+#define LOD_SELECTION_H
+
+#include <cstddef>
+#include "Mesh.h"
+
+// A level is good enough while its error covers at most LOD_PIXEL_ERROR pixels on screen. Switching
+// coarser needs the error below (1 - LOD_HYSTERESIS) of that and switching finer needs it above
+// (1 + LOD_HYSTERESIS), so a mesh near a threshold does not flicker between levels.
+const float LOD_PIXEL_ERROR = 1.0f;
+const float LOD_HYSTERESIS = 0.25f;
+
+struct LodStats {
+    size_t meshes[MAX_LODS] = {};   // visible meshes drawn at each level
+    size_t triangles = 0;           // triangles submitted
+    size_t fullTriangles = 0;       // what LOD 0 everywhere would have submitted
+};
+
+// pixelsPerUnit: screen pixels covered by one model-space unit at the mesh's nearest point.
+inline unsigned int SelectLod(const Mesh& mesh, float pixelsPerUnit, unsigned int current)
+{
+    unsigned int count = mesh.LodCount();
+    if (current >= count)
+        current = count - 1;
+    while (current > 0 && mesh.GetLod(current).error * pixelsPerUnit > LOD_PIXEL_ERROR * (1.0f + LOD_HYSTERESIS))
+        current--;
+    while (current + 1 < count && mesh.GetLod(current + 1).error * pixelsPerUnit <= LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+        current++;
+    return current;
+}
+
+#endif
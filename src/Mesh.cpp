@@ -1,16 +1,246 @@
 #include "Mesh.h"
+#include "MeshBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+namespace {
+
+uint32_t packUnitVector(glm::vec3 v, float w, glm::vec3 fallback)
+{
+    float length = glm::length(v);
+    if (!(length > 1e-6f) || !std::isfinite(length))
+        v = fallback;
+    else
+        v /= length;
+    return glm::packSnorm3x10_1x2(glm::vec4(v, w));
+}
+
+}
+
+size_t VertexStride(VertexFormat format)
+{
+    return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+void PackVertices(const Vertex* vertices, size_t count, VertexFormat format, vector<unsigned char>& out)
+{
+    out.resize(count * VertexStride(format));
+    if (format == VertexFormat::Full) {
+        if (count) memcpy(out.data(), vertices, out.size());
+        return;
+    }
+
+    PackedVertex* packed = reinterpret_cast<PackedVertex*>(out.data());
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& v = vertices[i];
+        glm::vec3 normal = glm::length(v.Normal) > 1e-6f ? glm::normalize(v.Normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+        // Gram-Schmidt so the shader can rebuild the bitangent as cross(N, T) * sign.
+        glm::vec3 tangent = v.Tangent - normal * glm::dot(normal, v.Tangent);
+        float sign = glm::dot(glm::cross(normal, tangent), v.Bitangent) < 0.0f ? -1.0f : 1.0f;
+
+        packed[i].Position = v.Position;
+        packed[i].Normal = packUnitVector(normal, 0.0f, glm::vec3(0.0f, 0.0f, 1.0f));
+        packed[i].Tangent = packUnitVector(tangent, sign, glm::vec3(1.0f, 0.0f, 0.0f));
+        packed[i].TexCoord = glm::packHalf2x16(v.TexCoord);
+    }
+}
+
+unsigned int PackIndices(const unsigned int* indices, size_t count, size_t vertexCount, vector<unsigned char>& out)
+{
+    if (vertexCount > 65536) {
+        out.resize(count * sizeof(unsigned int));
+        if (count) memcpy(out.data(), indices, out.size());
+        return sizeof(unsigned int);
+    }
+    out.resize(count * sizeof(uint16_t));
+    uint16_t* narrow = reinterpret_cast<uint16_t*>(out.data());
+    for (size_t i = 0; i < count; i++)
+        narrow[i] = static_cast<uint16_t>(indices[i]);
+    return sizeof(uint16_t);
+}
+
+unsigned int ConcatLods(const vector<unsigned int>& indices, const vector<MeshLod>& lods, vector<unsigned int>& out,
+    LodRange ranges[MAX_LODS])
+{
+    out = indices;
+    ranges[0] = { 0, indices.size(), 0.0f };
+    unsigned int count = 1;
+    for (const MeshLod& lod : lods) {
+        if (count == MAX_LODS)
+            break;
+        ranges[count++] = { out.size(), lod.indices.size(), lod.error };
+        out.insert(out.end(), lod.indices.begin(), lod.indices.end());
+    }
+    return count;
+}
+
+MeshBuffers PackMeshBuffers(const vector<Vertex>& vertices, const vector<unsigned int>& indices, const vector<MeshLod>& lods,
+    VertexFormat format, vector<unsigned char>& vertexBytes, vector<unsigned char>& indexBytes)
+{
+    vector<unsigned int> allIndices;
+    PackVertices(vertices.data(), vertices.size(), format, vertexBytes);
+    MeshBuffers buffers;
+    buffers.format = format;
+    buffers.vertices = vertexBytes.data();
+    buffers.vertexCount = vertices.size();
+    buffers.lodCount = ConcatLods(indices, lods, allIndices, buffers.lods);
+    buffers.indexSize = PackIndices(allIndices.data(), allIndices.size(), vertices.size(), indexBytes);
+    buffers.indices = indexBytes.data();
+    buffers.indexCount = allIndices.size();
+    return buffers;
+}
+
+MeshBounds ComputeBounds(const Vertex* vertices, size_t count)
+{
+    MeshBounds bounds = {};
+    if (count == 0)
+        return bounds;
+
+    bounds.box.min = bounds.box.max = vertices[0].Position;
+    for (size_t i = 1; i < count; i++) {
+        bounds.box.min = glm::min(bounds.box.min, vertices[i].Position);
+        bounds.box.max = glm::max(bounds.box.max, vertices[i].Position);
+    }
+
+    bounds.sphere.center = bounds.box.Center();
+    float radiusSq = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 offset = vertices[i].Position - bounds.sphere.center;
+        radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+    }
+    bounds.sphere.radius = std::sqrt(radiusSq);
+    return bounds;
+}
+
+void SetupVertexAttributes(VertexFormat format, size_t baseOffset)
+{
+    const char* base = reinterpret_cast<const char*>(baseOffset);
+    if (format == VertexFormat::Packed) {
+        GLsizei stride = sizeof(PackedVertex);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(PackedVertex, Position));
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, base + offsetof(PackedVertex, Normal));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, base + offsetof(PackedVertex, TexCoord));
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, base + offsetof(PackedVertex, Tangent));
+
+        // No bitangent stream: the shader sees (0,0,0) and rebuilds it from the tangent sign.
+        glDisableVertexAttribArray(4);
+        glVertexAttrib3f(4, 0.0f, 0.0f, 0.0f);
+        return;
+    }
+
+    GLsizei stride = sizeof(Vertex);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(Vertex, Position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(Vertex, Normal));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, base + offsetof(Vertex, TexCoord));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(Vertex, Tangent));
+
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(Vertex, Bitangent));
+}
+
+void SetupInstanceAttributes(size_t baseOffset)
+{
+    for (int column = 0; column < 4; column++) {
+        GLuint location = INSTANCE_MATRIX_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+            reinterpret_cast<const void*>(baseOffset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+void DisableInstanceAttributes()
+{
+    for (int column = 0; column < 4; column++)
+        glDisableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+}
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format,
+    MeshBatch* batch, vector<MeshLod> lods)
+    : batch(batch)
 {
     this->vertices = vertices;
     this->indices = indices;
     this->textures = textures;
+    this->lods = lods;
+
+    vector<unsigned char> vertexBytes, indexBytes;
+    MeshBuffers buffers = PackMeshBuffers(this->vertices, this->indices, this->lods, format, vertexBytes, indexBytes);
+
+    setupSamplerNames();
+    setupMesh(buffers);
+}
+
+Mesh::Mesh(const MeshBuffers& buffers, vector<Texture> textures, MeshBatch* batch)
+    : batch(batch)
+{
+    this->textures = textures;
 
-    setupMesh();
+    setupSamplerNames();
+    setupMesh(buffers);
 }
 
-void Mesh::setupMesh()
+Mesh Mesh::ShareGeometry() const
 {
+    Mesh copy;
+    copy.textures = textures;
+    copy.transparent = transparent;
+    copy.bounds = bounds;
+    copy.node = node;
+    copy.geometry = geometry;
+    copy.VAO = VAO;
+    copy.VBO = VBO;
+    copy.EBO = EBO;
+    copy.vertexCount = vertexCount;
+    copy.indexCount = indexCount;
+    copy.indexType = indexType;
+    copy.indexSize = indexSize;
+    copy.lodCount = lodCount;
+    std::copy(lodRanges, lodRanges + MAX_LODS, copy.lodRanges);
+    copy.gpuBytes = gpuBytes;
+    copy.samplerNames = samplerNames;
+    copy.samplers = samplers;
+    copy.samplerProgram = samplerProgram;
+    copy.batch = batch;
+    copy.batchRange = batchRange;
+    return copy;
+}
+
+void Mesh::setupMesh(const MeshBuffers& buffers)
+{
+    vertexCount = static_cast<unsigned int>(buffers.vertexCount);
+    indexCount = static_cast<unsigned int>(buffers.indexCount);
+    indexType = buffers.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    indexSize = buffers.indexSize;
+    lodCount = buffers.lodCount;
+    for (unsigned int i = 0; i < lodCount; i++)
+        lodRanges[i] = buffers.lods[i];
+    size_t vertexBytes = buffers.vertexCount * VertexStride(buffers.format);
+    size_t indexBytes = buffers.indexCount * buffers.indexSize;
+    gpuBytes = vertexBytes + indexBytes;
+
+    VAO = VBO = EBO = 0;
+    if (batch) {
+        batchRange = batch->Append(buffers);
+        return;
+    }
+
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
@@ -18,39 +248,23 @@ void Mesh::setupMesh()
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, buffers.vertices, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-        &indices[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoord));
-
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes,
+        buffers.indices, GL_STATIC_DRAW);
 
+    SetupVertexAttributes(buffers.format);
 
     glBindVertexArray(0);
 }
 
-void Mesh::Draw(Shader& shader)
+void Mesh::setupSamplerNames()
 {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     for (unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
-
         std::string number;
         std::string name = textures[i].type;
 
@@ -59,13 +273,65 @@ void Mesh::Draw(Shader& shader)
         else if (name == "texture_specular")
             number = std::to_string(specularNr++);
 
-        shader.setInt(("material." + name + number).c_str(), i);
+        samplerNames.push_back("material." + name + number);
+    }
+}
+
+void Mesh::BindTextures(Shader& shader)
+{
+    if (samplerProgram != shader.ID)
+    {
+        samplers.clear();
+        for (const string& name : samplerNames)
+            samplers.push_back(shader.getUniform<int>(name));
+        samplerProgram = shader.ID;
+    }
+
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        shader.set(samplers[i], i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
     glActiveTexture(GL_TEXTURE0);
+}
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+void Mesh::Draw(Shader& shader)
+{
+    BindTextures(shader);
+    DrawGeometry();
     glBindVertexArray(0);
 }
 
+void Mesh::DrawGeometry(unsigned int lod) const
+{
+    if (batch) {
+        batch->Bind();
+        batch->DrawRange(GetBatchRange(lod));
+    }
+    else {
+        const LodRange& range = lodRanges[lod];
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType,
+            reinterpret_cast<const void*>(range.firstIndex * indexSize));
+    }
+}
+
+void Mesh::BindVertexArray() const
+{
+    if (batch)
+        batch->Bind();
+    else
+        glBindVertexArray(VAO);
+}
+
+void Mesh::DrawInstanced(unsigned int lod, unsigned int count) const
+{
+    if (batch) {
+        batch->DrawInstanced(GetBatchRange(lod), count);
+        return;
+    }
+    const LodRange& range = lodRanges[lod];
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType,
+        reinterpret_cast<const void*>(range.firstIndex * indexSize), static_cast<GLsizei>(count));
+}
\ No newline at end of file
@@ -2,15 +2,18 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Shader.h"
+#include "Bounds.h"
 
 using namespace std;
 
 
 #define MAX_BONE_INFLUENCE 4
+#define MAX_LODS 4
 
 struct Vertex {
     glm::vec3 Position;
@@ -22,6 +25,69 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// GPU layout chosen when a model is loaded. Full uploads Vertex as is (88 bytes);
+// Packed drops the bone channels and quantizes everything else into PackedVertex.
+enum class VertexFormat : uint32_t {
+    Full = 0,
+    Packed = 1
+};
+
+struct PackedVertex {
+    glm::vec3 Position;
+    uint32_t Normal;      // GL_INT_2_10_10_10_REV, normalized
+    uint32_t Tangent;     // GL_INT_2_10_10_10_REV, normalized, w = bitangent sign
+    uint32_t TexCoord;    // two half floats
+};
+
+// A simplified index buffer over the mesh's own vertices. error is the geometric deviation from
+// LOD 0 in model units.
+struct MeshLod {
+    vector<unsigned int> indices;
+    float error;
+};
+
+// Where one level of detail lives inside MeshBuffers::indices.
+struct LodRange {
+    size_t firstIndex;
+    size_t indexCount;
+    float error;
+};
+
+// GPU-ready vertex and index bytes, either owned by the caller or mapped from a MeshCache.
+struct MeshBuffers {
+    VertexFormat format;
+    const void* vertices;
+    size_t vertexCount;
+    const void* indices;      // every LOD back to back, LOD 0 first
+    size_t indexCount;        // all LODs together
+    unsigned int indexSize;   // 2 or 4 bytes
+    unsigned int lodCount;
+    LodRange lods[MAX_LODS];
+};
+
+size_t VertexStride(VertexFormat format);
+void PackVertices(const Vertex* vertices, size_t count, VertexFormat format, vector<unsigned char>& out);
+// 16-bit indices whenever every vertex is addressable with them.
+unsigned int PackIndices(const unsigned int* indices, size_t count, size_t vertexCount, vector<unsigned char>& out);
+// LOD 0 followed by the simplified levels in one array; fills ranges and returns the level count.
+unsigned int ConcatLods(const vector<unsigned int>& indices, const vector<MeshLod>& lods, vector<unsigned int>& out,
+    LodRange ranges[MAX_LODS]);
+// Packs vertices and every LOD's indices into GPU-ready bytes; the returned buffers point into them.
+MeshBuffers PackMeshBuffers(const vector<Vertex>& vertices, const vector<unsigned int>& indices, const vector<MeshLod>& lods,
+    VertexFormat format, vector<unsigned char>& vertexBytes, vector<unsigned char>& indexBytes);
+// Box from the positions, sphere around the box centre.
+MeshBounds ComputeBounds(const Vertex* vertices, size_t count);
+// Attribute pointers for the VBO currently bound to GL_ARRAY_BUFFER, starting at baseOffset.
+void SetupVertexAttributes(VertexFormat format, size_t baseOffset = 0);
+
+// Per-instance model matrix (one column per location) read from the VBO bound to GL_ARRAY_BUFFER,
+// at baseOffset into a tightly packed glm::mat4 array. Applies to the bound VAO.
+#define INSTANCE_MATRIX_LOCATION 5
+void SetupInstanceAttributes(size_t baseOffset);
+void DisableInstanceAttributes();
+
+class MeshBatch;
+
 struct Texture {
     unsigned int id;
     string type;
@@ -35,12 +101,64 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // Material is alpha blended (glTF alphaMode BLEND); drawn in the RenderQueue transparent layer.
+    bool                 transparent = false;
+    MeshBounds           bounds = {};
+    // Index of the ModelNode this mesh hangs off.
+    unsigned int         node = 0;
+    // LOD 1 and coarser; indices above is LOD 0. Empty for meshes loaded from the cache.
+    vector<MeshLod>      lods;
+    // Index of the first mesh of the model with identical vertices, indices and material (the mesh's
+    // own index if there is none). Copies share that mesh's GPU buffers and are drawn instanced.
+    unsigned int         geometry = 0;
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
+    // With a batch the geometry is staged into its shared buffers instead of a VAO of its own;
+    // the batch must outlive the mesh and be uploaded before the first Draw.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VertexFormat::Full,
+        MeshBatch* batch = nullptr, vector<MeshLod> lods = {});
+    // Uploads straight from caller-owned memory (e.g. a mapped MeshCache); vertices/indices stay empty.
+    Mesh(const MeshBuffers& buffers, vector<Texture> textures, MeshBatch* batch = nullptr);
+    // Another user of this mesh's geometry: same GPU buffers, draw ranges, bounds and material, but
+    // none of the CPU-side vertices, indices or LODs, which only the first user keeps.
+    Mesh ShareGeometry() const;
     void Draw(Shader& shader);
+    void BindTextures(Shader& shader);
+    // Binds the mesh VAO (or its batch VAO) and draws the given level; textures are left as they are.
+    void DrawGeometry(unsigned int lod = 0) const;
+    // Binds the VAO holding the geometry: the mesh's own or its batch's.
+    void BindVertexArray() const;
+    // Draws count instances of the given level; the VAO must be bound and the instance attributes set up.
+    void DrawInstanced(unsigned int lod, unsigned int count) const;
+
+    MeshBatch* GetBatch() const { return batch; }
+    // The batch holds one range per level, consecutively.
+    unsigned int GetBatchRange(unsigned int lod = 0) const { return batchRange + lod; }
+
+    unsigned int LodCount() const { return lodCount; }
+    const LodRange& GetLod(unsigned int lod) const { return lodRanges[lod]; }
+
+    // Bytes this mesh occupies on the GPU, and what the full 88-byte Vertex / 32-bit index layout would take.
+    size_t GpuBytes() const { return gpuBytes; }
+    size_t FullFormatBytes() const { return vertexCount * sizeof(Vertex) + indexCount * sizeof(unsigned int); }
 
 private:
+    Mesh() = default;
+
     unsigned int VAO, VBO, EBO;
-    
-    void setupMesh();
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    GLenum indexType;
+    unsigned int indexSize;
+    unsigned int lodCount;
+    LodRange lodRanges[MAX_LODS];
+    size_t gpuBytes;
+    // "material.<type><n>" sampler per texture, resolved against samplerProgram.
+    vector<string> samplerNames;
+    vector<Uniform<int>> samplers;
+    unsigned int samplerProgram = 0;
+    MeshBatch* batch = nullptr;
+    unsigned int batchRange = 0;
+
+    void setupSamplerNames();
+    void setupMesh(const MeshBuffers& buffers);
 };
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "MeshBatch.h"
+#include <algorithm>
+#include <cstring>
+
+MeshBatch::MeshBatch(VertexFormat format) : format(format)
+{
+}
+
+MeshBatch::~MeshBatch()
+{
+    if (VAO) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+}
+
+unsigned int MeshBatch::Append(const MeshBuffers& buffers)
+{
+    if (buffers.format != format)
+        std::cout << "ERROR::MESH_BATCH::Vertex format mismatch" << std::endl;
+
+    size_t stride = VertexStride(format);
+    GLint baseVertex = static_cast<GLint>(stagedVertices.size() / stride);
+    GLenum indexType = buffers.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    // Index offsets have to be aligned to the index size.
+    size_t padding = (buffers.indexSize - stagedIndices.size() % buffers.indexSize) % buffers.indexSize;
+    stagedIndices.resize(stagedIndices.size() + padding, 0);
+    size_t indexOffset = stagedIndices.size();
+
+    const unsigned char* vertices = static_cast<const unsigned char*>(buffers.vertices);
+    const unsigned char* indices = static_cast<const unsigned char*>(buffers.indices);
+    stagedVertices.insert(stagedVertices.end(), vertices, vertices + buffers.vertexCount * stride);
+    stagedIndices.insert(stagedIndices.end(), indices, indices + buffers.indexCount * buffers.indexSize);
+
+    // One range per level, all on the same vertices.
+    unsigned int first = static_cast<unsigned int>(ranges.size());
+    for (unsigned int lod = 0; lod < buffers.lodCount; lod++) {
+        Range range;
+        range.baseVertex = baseVertex;
+        range.indexOffset = indexOffset + buffers.lods[lod].firstIndex * buffers.indexSize;
+        range.indexCount = static_cast<GLsizei>(buffers.lods[lod].indexCount);
+        range.indexType = indexType;
+        ranges.push_back(range);
+    }
+    return first;
+}
+
+void MeshBatch::Upload()
+{
+    while (!UploadStep(static_cast<size_t>(-1))) {
+    }
+}
+
+bool MeshBatch::UploadStep(size_t maxBytes)
+{
+    if (!VAO) {
+        vertexBytes = stagedVertices.size();
+        indexBytes = stagedIndices.size();
+        uploadedBytes = 0;
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, GL_STATIC_DRAW);
+        SetupVertexAttributes(format);
+        glBindVertexArray(0);
+    }
+
+    // The copy target leaves the element binding of whatever VAO is bound alone.
+    size_t total = vertexBytes + indexBytes;
+    size_t end = uploadedBytes + std::min(maxBytes, total - uploadedBytes);
+    if (uploadedBytes < vertexBytes) {
+        size_t last = std::min(end, vertexBytes);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, uploadedBytes, last - uploadedBytes, stagedVertices.data() + uploadedBytes);
+        uploadedBytes = last;
+    }
+    if (uploadedBytes < end) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, uploadedBytes - vertexBytes, end - uploadedBytes,
+            stagedIndices.data() + (uploadedBytes - vertexBytes));
+        uploadedBytes = end;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (uploadedBytes < total)
+        return false;
+
+    vector<unsigned char>().swap(stagedVertices);
+    vector<unsigned char>().swap(stagedIndices);
+    return true;
+}
+
+void MeshBatch::Bind() const
+{
+    glBindVertexArray(VAO);
+}
+
+void MeshBatch::DrawRange(unsigned int range) const
+{
+    const Range& r = ranges[range];
+    glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, r.indexType,
+        reinterpret_cast<const void*>(r.indexOffset), r.baseVertex);
+}
+
+void MeshBatch::DrawInstanced(unsigned int range, unsigned int count) const
+{
+    const Range& r = ranges[range];
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, r.indexCount, r.indexType,
+        reinterpret_cast<const void*>(r.indexOffset), static_cast<GLsizei>(count), r.baseVertex);
+}
+
+void MeshBatch::AddToList(unsigned int range, MultiDrawList& list) const
+{
+    const Range& r = ranges[range];
+    list.indexType = r.indexType;
+    list.counts.push_back(r.indexCount);
+    list.offsets.push_back(reinterpret_cast<const void*>(r.indexOffset));
+    list.baseVertices.push_back(r.baseVertex);
+}
+
+void MeshBatch::Draw(const MultiDrawList& list) const
+{
+    if (list.counts.empty())
+        return;
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, list.counts.data(), list.indexType, list.offsets.data(),
+        static_cast<GLsizei>(list.counts.size()), list.baseVertices.data());
+}
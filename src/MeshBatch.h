@@ -0,0 +1,71 @@
+#ifndef MESH_BATCH_H
+#define MESH_BATCH_H
+
+#include <glad/glad.h>
+#include <vector>
+#include "Mesh.h"
+
+// Per-draw arrays for one glMultiDrawElementsBaseVertex call; every entry shares indexType.
+struct MultiDrawList {
+    GLenum indexType = GL_UNSIGNED_INT;
+    vector<GLsizei> counts;
+    vector<const void*> offsets;
+    vector<GLint> baseVertices;
+
+    void Clear()
+    {
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+    }
+};
+
+// Shared vertex and index buffers behind one VAO. Meshes are staged with Append() while a model
+// loads, then Upload() (or UploadStep() over several frames) creates the GL objects once. Each
+// mesh keeps its own indices (16- or 32-bit) and is addressed through a base vertex and an index
+// byte offset.
+class MeshBatch {
+public:
+    struct Range {
+        GLint baseVertex;
+        size_t indexOffset;
+        GLsizei indexCount;
+        GLenum indexType;
+    };
+
+    explicit MeshBatch(VertexFormat format);
+    ~MeshBatch();
+    MeshBatch(const MeshBatch&) = delete;
+    MeshBatch& operator=(const MeshBatch&) = delete;
+
+    // Copies the mesh into the staging buffers and returns the range id of its LOD 0; the other
+    // levels follow consecutively. Must match the batch format.
+    unsigned int Append(const MeshBuffers& buffers);
+    void Upload();
+    // Creates the GL objects on the first call and copies at most maxBytes of staged data per call;
+    // returns true once everything is on the GPU and the staging memory is released.
+    bool UploadStep(size_t maxBytes);
+
+    void Bind() const;
+    // Draws a single range; the batch VAO must be bound.
+    void DrawRange(unsigned int range) const;
+    void DrawInstanced(unsigned int range, unsigned int count) const;
+    void AddToList(unsigned int range, MultiDrawList& list) const;
+    // Submits the whole list as one multi-draw; the batch VAO must be bound.
+    void Draw(const MultiDrawList& list) const;
+
+    const Range& GetRange(unsigned int range) const { return ranges[range]; }
+    size_t RangeCount() const { return ranges.size(); }
+    size_t GpuBytes() const { return vertexBytes + indexBytes; }
+
+private:
+    VertexFormat format;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    vector<Range> ranges;
+    vector<unsigned char> stagedVertices;
+    vector<unsigned char> stagedIndices;
+    size_t vertexBytes = 0, indexBytes = 0;
+    size_t uploadedBytes = 0;   // of vertexBytes + indexBytes, vertices first
+};
+
+#endif
@@ -0,0 +1,365 @@
+#include "MeshCache.h"
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char MAGIC[4] = { 'M', 'S', 'H', 'C' };
+const uint64_t DATA_ALIGNMENT = 16;
+const uint32_t MESH_FLAG_TRANSPARENT = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t meshCount;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t vertexFormat;
+    uint32_t vertexStride;
+    uint32_t pathLength;
+    double coldLoadMs;
+    uint32_t textureCount;
+    uint32_t stringsSize;
+    uint32_t nodeCount;
+    uint32_t reserved;
+};
+
+struct MeshRecord {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t flags;
+    float boundsMin[3];
+    float boundsMax[3];
+    float sphere[4];
+    uint32_t node;
+    uint32_t lodCount;
+    uint32_t lodFirstIndex[MAX_LODS];
+    uint32_t lodIndexCount[MAX_LODS];
+    float lodError[MAX_LODS];
+    uint32_t geometry;        // earlier record whose vertex/index data this one points at
+    uint32_t reserved;
+};
+
+struct NodeRecord {
+    int32_t parent;
+    float local[16];
+};
+
+struct TextureRecord {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+uint64_t alignUp(uint64_t value)
+{
+    return (value + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+}
+
+// Digest of the model file and, for glTF, of the .bin buffers it references, since the vertex
+// data lives there and can change without the .gltf changing.
+bool sourceDigest(const std::string& sourcePath, uint64_t& hash, uint64_t& size)
+{
+    if (!FileDigest(sourcePath, hash, size)) return false;
+    const size_t dot = sourcePath.find_last_of('.');
+    if (dot == std::string::npos || sourcePath.compare(dot, std::string::npos, ".gltf") != 0)
+        return true;
+
+    MappedFile gltf;
+    if (!gltf.Open(sourcePath)) return false;
+    const std::string json(reinterpret_cast<const char*>(gltf.Data()), gltf.Size());
+    const size_t slash = sourcePath.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? "" : sourcePath.substr(0, slash + 1);
+
+    for (size_t key = json.find("\"uri\""); key != std::string::npos; key = json.find("\"uri\"", key + 5)) {
+        const size_t open = json.find('"', json.find(':', key + 5));
+        const size_t close = open == std::string::npos ? std::string::npos : json.find('"', open + 1);
+        if (close == std::string::npos) break;
+        const std::string uri = json.substr(open + 1, close - open - 1);
+        if (uri.size() < 4 || uri.compare(uri.size() - 4, 4, ".bin") != 0)
+            continue;
+
+        uint64_t bufferHash, bufferSize;
+        if (!FileDigest(directory + uri, bufferHash, bufferSize)) return false;
+        hash = (hash ^ bufferHash) * 1099511628211ull;
+        size += bufferSize;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string MeshCache::CachePathFor(const std::string& sourcePath)
+{
+    return sourcePath + ".meshcache";
+}
+
+bool MeshCache::Open(const std::string& sourcePath, unsigned int importFlags, VertexFormat format)
+{
+    Close();
+
+    uint64_t sourceHash, sourceSize;
+    if (!sourceDigest(sourcePath, sourceHash, sourceSize)) return false;
+    if (!file.Open(CachePathFor(sourcePath))) return false;
+
+    const unsigned char* base = file.Data();
+    const size_t fileSize = file.Size();
+    if (fileSize < sizeof(CacheHeader)) { Close(); return false; }
+
+    CacheHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION ||
+        header.importFlags != importFlags ||
+        header.vertexFormat != static_cast<uint32_t>(format) ||
+        header.vertexStride != VertexStride(format) ||
+        header.sourceHash != sourceHash ||
+        header.sourceSize != sourceSize)
+    {
+        Close();
+        return false;
+    }
+
+    uint64_t cursor = sizeof(CacheHeader);
+    uint64_t tablesEnd = cursor + header.pathLength + uint64_t(header.meshCount) * sizeof(MeshRecord) +
+        uint64_t(header.textureCount) * sizeof(TextureRecord) + uint64_t(header.nodeCount) * sizeof(NodeRecord) +
+        header.stringsSize;
+    if (tablesEnd > fileSize ||
+        std::string(reinterpret_cast<const char*>(base + cursor), header.pathLength) != sourcePath)
+    {
+        Close();
+        return false;
+    }
+    cursor += header.pathLength;
+
+    const unsigned char* meshTable = base + cursor;
+    cursor += uint64_t(header.meshCount) * sizeof(MeshRecord);
+    const unsigned char* textureTable = base + cursor;
+    cursor += uint64_t(header.textureCount) * sizeof(TextureRecord);
+    const unsigned char* nodeTable = base + cursor;
+    cursor += uint64_t(header.nodeCount) * sizeof(NodeRecord);
+    const char* strings = reinterpret_cast<const char*>(base + cursor);
+
+    meshes.reserve(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        MeshRecord record;
+        std::memcpy(&record, meshTable + i * sizeof(MeshRecord), sizeof(record));
+        if ((record.indexSize != 2 && record.indexSize != 4) ||
+            record.vertexOffset + uint64_t(record.vertexCount) * header.vertexStride > fileSize ||
+            record.indexOffset + uint64_t(record.indexCount) * record.indexSize > fileSize ||
+            uint64_t(record.firstTexture) + record.textureCount > header.textureCount ||
+            record.node >= header.nodeCount ||
+            record.lodCount == 0 || record.lodCount > MAX_LODS ||
+            record.geometry > i)
+        {
+            Close();
+            return false;
+        }
+
+        CachedMeshView view;
+        view.buffers.format = format;
+        view.buffers.vertices = base + record.vertexOffset;
+        view.buffers.vertexCount = record.vertexCount;
+        view.buffers.indices = base + record.indexOffset;
+        view.buffers.indexCount = record.indexCount;
+        view.buffers.indexSize = record.indexSize;
+        view.buffers.lodCount = record.lodCount;
+        for (uint32_t lod = 0; lod < record.lodCount; lod++) {
+            if (uint64_t(record.lodFirstIndex[lod]) + record.lodIndexCount[lod] > record.indexCount) {
+                Close();
+                return false;
+            }
+            view.buffers.lods[lod].firstIndex = record.lodFirstIndex[lod];
+            view.buffers.lods[lod].indexCount = record.lodIndexCount[lod];
+            view.buffers.lods[lod].error = record.lodError[lod];
+        }
+        view.transparent = (record.flags & MESH_FLAG_TRANSPARENT) != 0;
+        view.bounds.box.min = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+        view.bounds.box.max = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+        view.bounds.sphere.center = glm::vec3(record.sphere[0], record.sphere[1], record.sphere[2]);
+        view.bounds.sphere.radius = record.sphere[3];
+        view.node = record.node;
+        view.geometry = record.geometry;
+        for (uint32_t t = 0; t < record.textureCount; t++) {
+            TextureRecord tex;
+            std::memcpy(&tex, textureTable + (record.firstTexture + t) * sizeof(TextureRecord), sizeof(tex));
+            if (uint64_t(tex.typeOffset) + tex.typeLength > header.stringsSize ||
+                uint64_t(tex.pathOffset) + tex.pathLength > header.stringsSize)
+            {
+                Close();
+                return false;
+            }
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign(strings + tex.typeOffset, tex.typeLength);
+            texture.path.assign(strings + tex.pathOffset, tex.pathLength);
+            view.textures.push_back(texture);
+        }
+        meshes.push_back(std::move(view));
+    }
+
+    nodes.resize(header.nodeCount);
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+        NodeRecord record;
+        std::memcpy(&record, nodeTable + i * sizeof(NodeRecord), sizeof(record));
+        if (record.parent >= static_cast<int32_t>(i)) {
+            Close();
+            return false;
+        }
+        nodes[i].parent = record.parent;
+        std::memcpy(&nodes[i].local, record.local, sizeof(record.local));
+    }
+
+    coldLoadMs = header.coldLoadMs;
+    return true;
+}
+
+void MeshCache::Close()
+{
+    meshes.clear();
+    nodes.clear();
+    file.Close();
+}
+
+bool MeshCache::Write(const std::string& sourcePath, unsigned int importFlags, VertexFormat format,
+    const std::vector<Mesh>& meshes, const std::vector<ModelNode>& nodes, double coldLoadMs)
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.importFlags = importFlags;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.vertexFormat = static_cast<uint32_t>(format);
+    header.vertexStride = static_cast<uint32_t>(VertexStride(format));
+    header.pathLength = static_cast<uint32_t>(sourcePath.size());
+    header.coldLoadMs = coldLoadMs;
+    if (!sourceDigest(sourcePath, header.sourceHash, header.sourceSize)) return false;
+
+    std::vector<TextureRecord> textureRecords;
+    std::string strings;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (meshes[i].geometry < i)
+            continue;
+        for (const Texture& texture : meshes[i].textures) {
+            TextureRecord record;
+            record.typeOffset = static_cast<uint32_t>(strings.size());
+            record.typeLength = static_cast<uint32_t>(texture.type.size());
+            strings += texture.type;
+            record.pathOffset = static_cast<uint32_t>(strings.size());
+            record.pathLength = static_cast<uint32_t>(texture.path.size());
+            strings += texture.path;
+            textureRecords.push_back(record);
+        }
+    }
+    header.textureCount = static_cast<uint32_t>(textureRecords.size());
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+
+    std::vector<NodeRecord> nodeRecords(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodeRecords[i].parent = nodes[i].parent;
+        std::memcpy(nodeRecords[i].local, &nodes[i].local, sizeof(nodeRecords[i].local));
+    }
+    header.nodeCount = static_cast<uint32_t>(nodeRecords.size());
+
+    uint64_t cursor = sizeof(CacheHeader) + header.pathLength + meshes.size() * sizeof(MeshRecord) +
+        textureRecords.size() * sizeof(TextureRecord) + nodeRecords.size() * sizeof(NodeRecord) + strings.size();
+
+    std::vector<MeshRecord> meshRecords;
+    std::vector<std::vector<unsigned char>> vertexBytes(meshes.size()), indexBytes(meshes.size());
+    uint32_t firstTexture = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const Mesh& mesh = meshes[i];
+        if (mesh.geometry < i) {
+            // Shared geometry is stored once; the copy only differs in its node.
+            MeshRecord record = meshRecords[mesh.geometry];
+            record.node = mesh.node;
+            record.geometry = mesh.geometry;
+            meshRecords.push_back(record);
+            continue;
+        }
+        PackVertices(mesh.vertices.data(), mesh.vertices.size(), format, vertexBytes[i]);
+        MeshRecord record = {};
+        std::vector<unsigned int> allIndices;
+        LodRange lods[MAX_LODS];
+        record.lodCount = ConcatLods(mesh.indices, mesh.lods, allIndices, lods);
+        for (uint32_t lod = 0; lod < record.lodCount; lod++) {
+            record.lodFirstIndex[lod] = static_cast<uint32_t>(lods[lod].firstIndex);
+            record.lodIndexCount[lod] = static_cast<uint32_t>(lods[lod].indexCount);
+            record.lodError[lod] = lods[lod].error;
+        }
+        record.indexSize = PackIndices(allIndices.data(), allIndices.size(), mesh.vertices.size(), indexBytes[i]);
+        record.vertexOffset = alignUp(cursor);
+        record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        cursor = record.vertexOffset + vertexBytes[i].size();
+        record.indexOffset = alignUp(cursor);
+        record.indexCount = static_cast<uint32_t>(allIndices.size());
+        cursor = record.indexOffset + indexBytes[i].size();
+        record.firstTexture = firstTexture;
+        record.textureCount = static_cast<uint32_t>(mesh.textures.size());
+        record.flags = mesh.transparent ? MESH_FLAG_TRANSPARENT : 0;
+        const MeshBounds& bounds = mesh.bounds;
+        for (int k = 0; k < 3; k++) {
+            record.boundsMin[k] = bounds.box.min[k];
+            record.boundsMax[k] = bounds.box.max[k];
+            record.sphere[k] = bounds.sphere.center[k];
+        }
+        record.sphere[3] = bounds.sphere.radius;
+        record.node = mesh.node;
+        record.geometry = static_cast<uint32_t>(i);
+        firstTexture += record.textureCount;
+        meshRecords.push_back(record);
+    }
+
+    const std::string cachePath = CachePathFor(sourcePath);
+    const std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(sourcePath.data(), sourcePath.size());
+        out.write(reinterpret_cast<const char*>(meshRecords.data()), meshRecords.size() * sizeof(MeshRecord));
+        out.write(reinterpret_cast<const char*>(textureRecords.data()), textureRecords.size() * sizeof(TextureRecord));
+        out.write(reinterpret_cast<const char*>(nodeRecords.data()), nodeRecords.size() * sizeof(NodeRecord));
+        out.write(strings.data(), strings.size());
+
+        const char padding[DATA_ALIGNMENT] = {};
+        uint64_t written = sizeof(CacheHeader) + header.pathLength + meshRecords.size() * sizeof(MeshRecord) +
+            textureRecords.size() * sizeof(TextureRecord) + nodeRecords.size() * sizeof(NodeRecord) + strings.size();
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const MeshRecord& record = meshRecords[i];
+            if (record.geometry != i)
+                continue;
+            out.write(padding, record.vertexOffset - written);
+            out.write(reinterpret_cast<const char*>(vertexBytes[i].data()), vertexBytes[i].size());
+            written = record.vertexOffset + vertexBytes[i].size();
+            out.write(padding, record.indexOffset - written);
+            out.write(reinterpret_cast<const char*>(indexBytes[i].data()), indexBytes[i].size());
+            written = record.indexOffset + indexBytes[i].size();
+        }
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::remove(tempPath.c_str());
+        std::cout << "Warning: could not write mesh cache " << cachePath << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "SceneGraph.h"
+
+// View of one mesh inside a mapped cache file. Pointers stay valid as long as the MeshCache is open.
+struct CachedMeshView {
+    MeshBuffers buffers;
+    vector<Texture> textures; // id == 0, only type and path are filled in
+    bool transparent;
+    MeshBounds bounds;
+    unsigned int node;
+    unsigned int geometry;    // index of the mesh whose buffers this one shares, its own index if none
+};
+
+// Versioned binary cache of the final vertex/index arrays produced by Model::processMesh, stored
+// GPU-ready in the requested VertexFormat. The file lives next to the source model and is keyed by
+// the source path, a digest of its contents (and of its .bin buffers for glTF), the Assimp import
+// flags and the vertex format, so any change to one of those makes it stale.
+class MeshCache {
+public:
+    static const uint32_t VERSION = 9;
+
+    static std::string CachePathFor(const std::string& sourcePath);
+
+    // Maps the cache for sourcePath; returns false if it is missing or stale.
+    bool Open(const std::string& sourcePath, unsigned int importFlags, VertexFormat format);
+    const std::vector<CachedMeshView>& GetMeshes() const { return meshes; }
+    const std::vector<ModelNode>& GetNodes() const { return nodes; }
+    // Load time of the Assimp import that produced this cache, in milliseconds.
+    double GetColdLoadMs() const { return coldLoadMs; }
+    void Close();
+
+    static bool Write(const std::string& sourcePath, unsigned int importFlags, VertexFormat format,
+        const std::vector<Mesh>& meshes, const std::vector<ModelNode>& nodes, double coldLoadMs);
+
+private:
+    MappedFile file;
+    std::vector<CachedMeshView> meshes;
+    std::vector<ModelNode> nodes;
+    double coldLoadMs = 0.0;
+};
+
+#endif
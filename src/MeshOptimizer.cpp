@@ -0,0 +1,315 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Forsyth scoring parameters from "Linear-Speed Vertex Cache Optimisation".
+const int FORSYTH_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else {
+            float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+}
+
+// Fields that affect shading; bone channels are left out since the importer never fills them.
+const size_t VERTEX_KEY_FLOATS = 14;
+
+typedef std::array<uint32_t, VERTEX_KEY_FLOATS> VertexKey;
+
+// Bit patterns rather than float compares, so -0.0 and NaN payloads never merge by accident.
+VertexKey vertexKey(const Vertex& v)
+{
+    VertexKey key;
+    memcpy(&key[0], &v.Position, sizeof(glm::vec3));
+    memcpy(&key[3], &v.Normal, sizeof(glm::vec3));
+    memcpy(&key[6], &v.TexCoord, sizeof(glm::vec2));
+    memcpy(&key[8], &v.Tangent, sizeof(glm::vec3));
+    memcpy(&key[11], &v.Bitangent, sizeof(glm::vec3));
+    return key;
+}
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t word : key) {
+            hash ^= word;
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+}
+
+VertexCacheStats AnalyzeVertexCache(const vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangles = indices.size() / 3;
+
+    // FIFO cache: a vertex is resident while its insertion stamp is within cacheSize of the clock.
+    vector<size_t> stamp(vertexCount, 0);
+    size_t clock = cacheSize + 1;
+    for (unsigned int index : indices) {
+        if (clock - stamp[index] > cacheSize) {
+            stamp[index] = clock++;
+            stats.transformed++;
+        }
+    }
+
+    if (stats.triangles)
+        stats.acmr = static_cast<float>(stats.transformed) / stats.triangles;
+    if (vertexCount)
+        stats.atvr = static_cast<float>(stats.transformed) / vertexCount;
+    return stats;
+}
+
+void DeduplicateVertices(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    unordered_map<VertexKey, unsigned int, VertexKeyHash> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> merged;
+    merged.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        VertexKey key = vertexKey(vertices[i]);
+        auto it = unique.find(key);
+        if (it == unique.end()) {
+            unsigned int id = static_cast<unsigned int>(merged.size());
+            unique.emplace(key, id);
+            merged.push_back(vertices[i]);
+            remap[i] = id;
+        }
+        else
+            remap[i] = it->second;
+    }
+
+    for (unsigned int& index : indices)
+        index = remap[index];
+    vertices.swap(merged);
+}
+
+void OptimizeVertexCache(vector<unsigned int>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Vertex -> triangle adjacency in one flat array.
+    vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    vector<bool> emitted(triangleCount, false);
+
+    vector<unsigned int> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    size_t scanCursor = 0;
+    long bestTriangle = 0;
+
+    while (result.size() < indices.size()) {
+        if (bestTriangle < 0) {
+            // Nothing adjacent to the cache is left: resume from the first unemitted triangle.
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            bestTriangle = static_cast<long>(scanCursor);
+        }
+
+        const unsigned int* tri = &indices[bestTriangle * 3];
+        emitted[bestTriangle] = true;
+        result.insert(result.end(), tri, tri + 3);
+
+        // Move the triangle's vertices to the front of the LRU cache.
+        nextCache.assign(tri, tri + 3);
+        for (unsigned int v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache.push_back(v);
+
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            unsigned int* begin = &adjacency[adjacencyOffset[v]];
+            unsigned int* end = begin + remaining[v];
+            *std::find(begin, end, static_cast<unsigned int>(bestTriangle)) = *(end - 1);
+            remaining[v]--;
+        }
+
+        for (size_t i = 0; i < nextCache.size(); i++)
+            cachePosition[nextCache[i]] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+        // Rescore everything that was or is in the cache, then pick the best neighbouring triangle.
+        for (unsigned int v : nextCache) {
+            float newScore = vertexScore(cachePosition[v], remaining[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + remaining[v]; a++)
+                triangleScore[adjacency[a]] += delta;
+        }
+
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : nextCache) {
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + remaining[v]; a++) {
+                unsigned int t = adjacency[a];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (nextCache.size() > FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+
+    indices.swap(result);
+}
+
+void OptimizeOverdraw(vector<unsigned int>& indices, const vector<Vertex>& vertices)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Cluster boundaries: triangles whose three vertices all miss the FIFO cache. Reordering
+    // whole clusters leaves the cache behaviour inside each cluster untouched.
+    vector<size_t> clusterStart;
+    vector<size_t> stamp(vertices.size(), 0);
+    size_t clock = ANALYZE_CACHE_SIZE + 1;
+    for (size_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            if (clock - stamp[v] > ANALYZE_CACHE_SIZE) {
+                stamp[v] = clock++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusterStart.push_back(t);
+    }
+    clusterStart.push_back(triangleCount);
+    size_t clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2)
+        return;
+
+    glm::vec3 meshCenter(0.0f);
+    for (const Vertex& v : vertices)
+        meshCenter += v.Position;
+    meshCenter /= static_cast<float>(vertices.size());
+
+    // Clusters facing away from the mesh centre are likely silhouettes/occluders: draw them first.
+    vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+            const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float a = glm::length(n);
+            center += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+            sortKey[c] = glm::dot(center / area - meshCenter, normal / normalLength);
+        else
+            sortKey[c] = 0.0f;
+    }
+
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+    indices.swap(result);
+}
+
+void OptimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+uint64_t GeometryHash(const vector<Vertex>& vertices, const vector<unsigned int>& indices)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(vertices.data(), vertices.size() * sizeof(Vertex));
+    mix(indices.data(), indices.size() * sizeof(unsigned int));
+    return hash;
+}
+
+void OptimizeMesh(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    DeduplicateVertices(vertices, indices);
+    OptimizeVertexCache(indices, vertices.size());
+    OptimizeOverdraw(indices, vertices);
+    OptimizeVertexFetch(vertices, indices);
+}
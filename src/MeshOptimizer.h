@@ -0,0 +1,40 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Mesh.h"
+
+// Post-transform cache statistics of an index buffer, simulated with a FIFO cache of
+// ANALYZE_CACHE_SIZE entries. ACMR = transformed vertices per triangle, ATVR = transformed
+// vertices per unique vertex (1.0 is perfect).
+struct VertexCacheStats {
+    size_t triangles = 0;
+    size_t transformed = 0;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+const unsigned int ANALYZE_CACHE_SIZE = 16;
+
+VertexCacheStats AnalyzeVertexCache(const vector<unsigned int>& indices, size_t vertexCount,
+    unsigned int cacheSize = ANALYZE_CACHE_SIZE);
+
+// Merges bit-identical vertices (position, normal, UV, tangent frame) and remaps the indices.
+void DeduplicateVertices(vector<Vertex>& vertices, vector<unsigned int>& indices);
+// Forsyth's linear-speed triangle reordering for an LRU post-transform cache.
+void OptimizeVertexCache(vector<unsigned int>& indices, size_t vertexCount);
+// Tipsify-style overdraw pass: splits the cache-ordered triangles into clusters at cache restarts
+// and draws outward-facing clusters first, so they tend to occlude the rest.
+void OptimizeOverdraw(vector<unsigned int>& indices, const vector<Vertex>& vertices);
+// Renumbers vertices in first-use order and drops unreferenced ones.
+void OptimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+// FNV-1a over the vertex and index bytes; equal hashes are candidates for sharing one GPU copy.
+uint64_t GeometryHash(const vector<Vertex>& vertices, const vector<unsigned int>& indices);
+
+// All of the above, in order.
+void OptimizeMesh(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+#endif
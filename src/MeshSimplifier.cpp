@@ -0,0 +1,276 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+// Symmetric 4x4 error quadric of the planes around a vertex, area weighted. Doubles, since the
+// plane offsets of a city-sized mesh lose the small errors in float.
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+    double weight = 0;
+
+    void AddPlane(double a, double b, double c, double d, double w)
+    {
+        a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+        b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+        c2 += w * c * c; cd += w * c * d;
+        d2 += w * d * d;
+        weight += w;
+    }
+
+    void Add(const Quadric& q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+    }
+
+    // Mean squared distance of p to the accumulated planes.
+    double Error(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+            + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+            + c2 * z * z + 2 * cd * z
+            + d2;
+        return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+// (cost, from, to); the vertex ids break ties so the order never depends on the heap internals.
+typedef std::tuple<double, unsigned int, unsigned int> Collapse;
+
+typedef std::array<uint32_t, 3> PositionKey;
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& key) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t word : key) {
+            hash ^= word;
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+glm::dvec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+{
+    return glm::cross(glm::dvec3(p1) - glm::dvec3(p0), glm::dvec3(p2) - glm::dvec3(p0));
+}
+
+}
+
+vector<unsigned int> SimplifyMesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+    size_t targetIndexCount, float maxError, float* resultError)
+{
+    if (resultError)
+        *resultError = 0.0f;
+    size_t vertexCount = vertices.size();
+    size_t triangleCount = indices.size() / 3;
+    if (indices.size() <= targetIndexCount || triangleCount == 0)
+        return indices;
+
+    // Vertices sharing a bit-identical position are one point of the surface; the first of them
+    // stands for the rest.
+    vector<unsigned int> position(vertexCount);
+    vector<unsigned int> wedges(vertexCount, 0);
+    std::unordered_map<PositionKey, unsigned int, PositionKeyHash> firstAt;
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        PositionKey key;
+        memcpy(key.data(), &vertices[v].Position, sizeof(glm::vec3));
+        auto it = firstAt.emplace(key, v).first;
+        position[v] = it->second;
+        wedges[it->second]++;
+    }
+
+    vector<unsigned int> triangles(indices);
+    vector<unsigned char> triangleAlive(triangleCount, 1);
+    vector<vector<unsigned int>> vertexTriangles(vertexCount);
+    vector<Quadric> quadrics(vertexCount);
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        const unsigned int* tri = &triangles[t * 3];
+        for (int k = 0; k < 3; k++)
+            vertexTriangles[position[tri[k]]].push_back(t);
+
+        glm::dvec3 normal = triangleNormal(vertices[tri[0]].Position, vertices[tri[1]].Position, vertices[tri[2]].Position);
+        double length = glm::length(normal);
+        if (!(length > 0.0))
+            continue;
+        normal /= length;
+        double d = -glm::dot(normal, glm::dvec3(vertices[tri[0]].Position));
+        for (int k = 0; k < 3; k++)
+            quadrics[position[tri[k]]].AddPlane(normal.x, normal.y, normal.z, d, length * 0.5);
+    }
+
+    // An edge used by a single triangle, in either direction, is an open border.
+    vector<unsigned char> locked(vertexCount, 0);
+    std::unordered_map<uint64_t, int> edgeUses;
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint64_t a = position[triangles[i + k]], b = position[triangles[i + (k + 1) % 3]];
+            edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+    }
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = position[triangles[i + k]], b = position[triangles[i + (k + 1) % 3]];
+            if (edgeUses[uint64_t(std::min(a, b)) << 32 | std::max(a, b)] == 1)
+                locked[a] = locked[b] = 1;
+        }
+    }
+    // Seam vertices carry several attribute sets; moving one wedge would tear the others.
+    for (unsigned int v = 0; v < vertexCount; v++)
+        if (position[v] == v && wedges[v] > 1)
+            locked[v] = 1;
+
+    std::priority_queue<Collapse, vector<Collapse>, std::greater<Collapse>> heap;
+    auto pushEdges = [&](unsigned int v) {
+        for (unsigned int t : vertexTriangles[v]) {
+            if (!triangleAlive[t])
+                continue;
+            for (int k = 0; k < 3; k++) {
+                unsigned int n = position[triangles[t * 3 + k]];
+                if (n == v)
+                    continue;
+                // Only single-wedge vertices collapse or are collapsed onto, so the vertex id is its position.
+                if (!locked[v] && wedges[n] == 1) {
+                    Quadric q = quadrics[v];
+                    q.Add(quadrics[n]);
+                    heap.emplace(q.Error(vertices[n].Position), v, n);
+                }
+                if (!locked[n] && wedges[v] == 1) {
+                    Quadric q = quadrics[n];
+                    q.Add(quadrics[v]);
+                    heap.emplace(q.Error(vertices[v].Position), n, v);
+                }
+            }
+        }
+    };
+    for (unsigned int v = 0; v < vertexCount; v++)
+        if (position[v] == v && !locked[v] && wedges[v] == 1)
+            pushEdges(v);
+
+    vector<unsigned char> removed(vertexCount, 0);
+    size_t liveTriangles = triangleCount;
+    double maxErrorSq = double(maxError) * double(maxError);
+    double worstError = 0.0;
+
+    while (!heap.empty() && liveTriangles * 3 > targetIndexCount) {
+        double cost;
+        unsigned int from, to;
+        std::tie(cost, from, to) = heap.top();
+        heap.pop();
+        if (removed[from] || removed[to])
+            continue;
+
+        // Merges since the entry was queued change the quadrics, and Error normalizes by their weight,
+        // so the stored cost may be off either way. A higher current cost requeues the edge; past that
+        // only the current cost counts.
+        Quadric merged = quadrics[from];
+        merged.Add(quadrics[to]);
+        double current = merged.Error(vertices[to].Position);
+        if (current > cost) {
+            heap.emplace(current, from, to);
+            continue;
+        }
+        if (current > maxErrorSq)
+            break;
+
+        // The edge must still exist, and no surviving triangle around from may flip or collapse to a sliver.
+        bool connected = false, flips = false;
+        for (unsigned int t : vertexTriangles[from]) {
+            if (!triangleAlive[t])
+                continue;
+            const unsigned int* tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                connected = true;
+                continue;
+            }
+            glm::vec3 p[3], moved[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = vertices[tri[k]].Position;
+                moved[k] = tri[k] == from ? vertices[to].Position : p[k];
+            }
+            glm::dvec3 before = triangleNormal(p[0], p[1], p[2]);
+            glm::dvec3 after = triangleNormal(moved[0], moved[1], moved[2]);
+            if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after)) {
+                flips = true;
+                break;
+            }
+        }
+        if (!connected || flips)
+            continue;
+
+        for (unsigned int t : vertexTriangles[from]) {
+            if (!triangleAlive[t])
+                continue;
+            unsigned int* tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                triangleAlive[t] = 0;
+                liveTriangles--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+                if (tri[k] == from)
+                    tri[k] = to;
+            vertexTriangles[to].push_back(t);
+        }
+        vector<unsigned int>& around = vertexTriangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(),
+            [&](unsigned int t) { return !triangleAlive[t]; }), around.end());
+        vector<unsigned int>().swap(vertexTriangles[from]);
+
+        quadrics[to] = merged;
+        removed[from] = 1;
+        worstError = std::max(worstError, current);
+        pushEdges(to);
+    }
+
+    vector<unsigned int> result;
+    result.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+        if (triangleAlive[t])
+            result.insert(result.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(worstError));
+    return result;
+}
+
+vector<MeshLod> BuildLodChain(const vector<Vertex>& vertices, const vector<unsigned int>& indices, float boundingRadius)
+{
+    vector<MeshLod> lods;
+    float error = 0.0f;
+    for (const LodLevelSettings& level : LOD_LEVELS) {
+        const vector<unsigned int>& previous = lods.empty() ? indices : lods.back().indices;
+        size_t target = static_cast<size_t>(indices.size() / 3 * level.triangleRatio) * 3;
+        float levelError;
+        vector<unsigned int> simplified = SimplifyMesh(vertices, previous, target,
+            boundingRadius * level.errorRatio, &levelError);
+        if (simplified.size() * 10 > previous.size() * 9)
+            break;
+
+        OptimizeVertexCache(simplified, vertices.size());
+        // Each level starts from the previous one, so the errors add up.
+        error += levelError;
+        MeshLod lod;
+        lod.indices = std::move(simplified);
+        lod.error = error;
+        lods.push_back(std::move(lod));
+    }
+    return lods;
+}
@@ -0,0 +1,32 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+
+// Quadric error edge collapse (Garland-Heckbert) using half-edge collapses only: a vertex is merged
+// into one of its neighbours, so the result indexes the same vertex array and every LOD shares the
+// mesh's vertex buffer. Vertices on open borders or UV/normal seams (several vertices at one
+// position) never move. Stops at targetIndexCount or before a collapse whose error, as a distance
+// in model units, would exceed maxError. Deterministic: the same input always gives the same output.
+vector<unsigned int> SimplifyMesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices,
+    size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+// Target triangle ratio and error budget (fraction of the bounding radius) of LOD 1, 2 and 3.
+struct LodLevelSettings {
+    float triangleRatio;
+    float errorRatio;
+};
+
+const LodLevelSettings LOD_LEVELS[MAX_LODS - 1] = {
+    { 0.5f, 0.01f },
+    { 0.25f, 0.03f },
+    { 0.125f, 0.08f }
+};
+
+// LOD 1.. for a mesh, each simplified from the one before and cache-optimized. A level that removes
+// less than 10% of the previous level's triangles ends the chain.
+vector<MeshLod> BuildLodChain(const vector<Vertex>& vertices, const vector<unsigned int>& indices, float boundingRadius);
+
+#endif
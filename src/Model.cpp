@@ -1,11 +1,254 @@
 #include "Model.h"
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "TextureLoader.h"
+#include "JobPool.h"
+#include "TangentSpace.h"
+#include <assimp/GltfMaterial.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace {
+
+const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs /* | aiProcess_CalcTangentSpace*/;
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// File of a material texture; empty for an embedded one ("*0"), which is not loaded.
+string textureFilename(const string& path, const string& directory)
+{
+	if (path.find('*') != string::npos)
+		return string();
+	return directory + '/' + path;
+}
+
+// Sums per-triangle tangents into the vertices (on top of what they hold) and normalizes them,
+// through the SoA kernels of TangentSpace.
+void generateTangents(vector<Vertex>& vertices, const vector<unsigned int>& indices)
+{
+	TangentStreams streams;
+	streams.Resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& vertex = vertices[i];
+		streams.px[i] = vertex.Position.x; streams.py[i] = vertex.Position.y; streams.pz[i] = vertex.Position.z;
+		streams.u[i] = vertex.TexCoord.x; streams.v[i] = vertex.TexCoord.y;
+		streams.tx[i] = vertex.Tangent.x; streams.ty[i] = vertex.Tangent.y; streams.tz[i] = vertex.Tangent.z;
+		streams.bx[i] = vertex.Bitangent.x; streams.by[i] = vertex.Bitangent.y; streams.bz[i] = vertex.Bitangent.z;
+	}
+	GenerateTangents(streams, indices, BestTangentKernel());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		vertices[i].Tangent = glm::vec3(streams.tx[i], streams.ty[i], streams.tz[i]);
+		vertices[i].Bitangent = glm::vec3(streams.bx[i], streams.by[i], streams.bz[i]);
+	}
+}
+
+}
 
 void Model::Draw(Shader& shader)
 {
-	for (unsigned int i = 0; i < meshes.size(); i++)
-		meshes[i].Draw(shader);
+	if (!batch)
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].Draw(shader);
+		return;
+	}
+
+	batch->Bind();
+	for (DrawGroup& group : drawGroups)
+	{
+		meshes[group.mesh].BindTextures(shader);
+		batch->Draw(group.list);
+	}
+	for (InstanceGroup& group : instanceGroups)
+	{
+		meshes[group.mesh].BindTextures(shader);
+		for (unsigned int member : group.members)
+			batch->DrawRange(meshes[member].GetBatchRange());
+	}
+	glBindVertexArray(0);
+}
+
+int Model::AttachTo(SceneGraph& graph, int parent)
+{
+	if (this->graph && this->graph != &graph)
+	{
+		cout << "ERROR::MODEL::AttachTo a second scene graph; all copies must share one" << endl;
+		return SceneGraph::NO_PARENT;
+	}
+	this->graph = &graph;
+	Attachment attachment;
+	attachment.rootNode = graph.AddNode(parent, glm::mat4(1.0f));
+	attachment.firstNode = static_cast<int>(graph.Size());
+	for (const ModelNode& node : nodes)
+		graph.AddNode(node.parent == SceneGraph::NO_PARENT ? attachment.rootNode : attachment.firstNode + node.parent, node.local);
+	attachment.groups.resize(drawGroups.size());
+	attachment.meshLod.assign(meshes.size(), 0);
+	attachments.push_back(std::move(attachment));
+	return attachments.back().rootNode;
+}
+
+void Model::Submit(RenderQueue& queue, Shader& shader, CullStats& cullStats, LodStats& lodStats)
+{
+	submit(queue, shader, cullStats, &lodStats);
+}
+
+void Model::SubmitShadowCasters(RenderQueue& queue, Shader& depthShader, CullStats& cullStats)
+{
+	submit(queue, depthShader, cullStats, nullptr);
+}
+
+AABB Model::WorldBounds() const
+{
+	if (!graph)
+		return bvh.Bounds();
+	AABB bounds = TransformBox(bvh.Bounds(), graph->GetWorld(attachments[0].rootNode));
+	for (size_t i = 1; i < attachments.size(); i++)
+	{
+		AABB box = TransformBox(bvh.Bounds(), graph->GetWorld(attachments[i].rootNode));
+		bounds.min = glm::min(bounds.min, box.min);
+		bounds.max = glm::max(bounds.max, box.max);
+	}
+	return bounds;
+}
+
+AABB Model::WorldBounds(int rootNode) const
+{
+	if (!graph)
+		return bvh.Bounds();
+	return TransformBox(bvh.Bounds(), graph->GetWorld(rootNode));
+}
+
+void Model::submit(RenderQueue& queue, Shader& shader, CullStats& cullStats, LodStats* lodStats)
+{
+	if (!graph)
+	{
+		cout << "ERROR::MODEL::Submit called before AttachTo" << endl;
+		return;
+	}
+
+	for (InstanceGroup& group : instanceGroups)
+	{
+		for (vector<glm::mat4>& instances : group.instances)
+			instances.clear();
+		group.nearestDepth = std::numeric_limits<float>::max();
+	}
+	const bool casters = lodStats == nullptr;
+	static const uint16_t casterMaterial = RenderQueue::MaterialId("shadow caster");
+
+	for (Attachment& attachment : attachments)
+	{
+		// The BVH is built in model-root space, so the frustum only needs the root's world matrix.
+		visibleMeshes.clear();
+		bvh.Query(Frustum::FromMatrix(queue.ViewProjection() * graph->GetWorld(attachment.rootNode)), visibleMeshes, cullStats);
+		if (visibleMeshes.empty())
+			continue;
+
+		for (GroupVisibility& group : attachment.groups)
+		{
+			group.visible.Clear();
+			group.visibleMeshes = 0;
+			group.nearestDepth = std::numeric_limits<float>::max();
+		}
+		for (unsigned int mesh : visibleMeshes)
+		{
+			const Mesh& current = meshes[mesh];
+			if (casters && current.transparent)
+				continue;
+			const glm::mat4& world = graph->GetWorld(attachment.firstNode + current.node);
+			glm::vec3 center = glm::vec3(world * glm::vec4(current.bounds.sphere.center, 1.0f));
+			float depth = queue.ViewDepth(center);
+			if (casters)
+			{
+				if (meshInstanceGroup[mesh] >= 0)
+				{
+					InstanceGroup& instanced = instanceGroups[meshInstanceGroup[mesh]];
+					instanced.instances[0].push_back(world);
+					instanced.nearestDepth = std::min(instanced.nearestDepth, depth);
+					continue;
+				}
+				GroupVisibility& group = attachment.groups[meshGroup[mesh]];
+				if (batch)
+					batch->AddToList(current.GetBatchRange(), group.visible);
+				group.visibleMeshes++;
+				group.nearestDepth = std::min(group.nearestDepth, depth);
+				continue;
+			}
+
+			// Error is measured at the nearest point of the bounding sphere, scaled by the largest axis scale.
+			float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])),
+				glm::length(glm::vec3(world[2]))));
+			float nearest = depth - current.bounds.sphere.radius * scale;
+			unsigned int lod = 0;
+			if (nearest > 0.0f)
+				lod = SelectLod(current, queue.ProjectedSize(scale, nearest), attachment.meshLod[mesh]);
+			attachment.meshLod[mesh] = static_cast<unsigned char>(lod);
+			lodStats->meshes[lod]++;
+			lodStats->triangles += current.GetLod(lod).indexCount / 3;
+			lodStats->fullTriangles += current.GetLod(0).indexCount / 3;
+
+			if (meshInstanceGroup[mesh] >= 0)
+			{
+				InstanceGroup& instanced = instanceGroups[meshInstanceGroup[mesh]];
+				instanced.instances[lod].push_back(world);
+				instanced.nearestDepth = std::min(instanced.nearestDepth, depth);
+				continue;
+			}
+			GroupVisibility& group = attachment.groups[meshGroup[mesh]];
+			if (batch)
+				batch->AddToList(current.GetBatchRange(lod), group.visible);
+			group.visibleMeshes++;
+			group.nearestDepth = std::min(group.nearestDepth, depth);
+		}
+
+		nodeTransforms.assign(nodes.size(), -1);
+		for (size_t i = 0; i < drawGroups.size(); i++)
+		{
+			const DrawGroup& group = drawGroups[i];
+			GroupVisibility& visibility = attachment.groups[i];
+			if (!visibility.visibleMeshes)
+				continue;
+			if (nodeTransforms[group.node] < 0)
+				nodeTransforms[group.node] = static_cast<int>(queue.AddTransform(graph->GetWorld(attachment.firstNode + group.node)));
+			RenderQueue::Layer layer = group.transparent ? RenderQueue::Transparent : RenderQueue::Opaque;
+			queue.Submit(layer, shader, casters ? casterMaterial : group.material, visibility.nearestDepth, meshes[group.mesh],
+				batch ? &visibility.visible : nullptr, casters ? 0 : normalMap, static_cast<uint32_t>(nodeTransforms[group.node]),
+				casters ? 0 : attachment.meshLod[group.mesh]);
+		}
+	}
+
+	// Instances of all copies go out together, one draw per shared geometry and LOD.
+	for (InstanceGroup& group : instanceGroups)
+	{
+		for (unsigned int lod = 0; lod < MAX_LODS; lod++)
+		{
+			const vector<glm::mat4>& instances = group.instances[lod];
+			if (instances.empty())
+				continue;
+			uint32_t first = queue.AddInstances(instances.data(), instances.size());
+			queue.SubmitInstanced(RenderQueue::Opaque, shader, casters ? casterMaterial : group.material, group.nearestDepth,
+				meshes[group.mesh], lod, casters ? 0 : normalMap, first, static_cast<uint32_t>(instances.size()));
+		}
+	}
+}
+
+void Model::SetNormalMap(unsigned int texture)
+{
+	normalMap = texture;
+	for (DrawGroup& group : drawGroups)
+		group.material = RenderQueue::MaterialId(group.materialKey + "|normal" + std::to_string(normalMap));
+	for (InstanceGroup& group : instanceGroups)
+		group.material = RenderQueue::MaterialId(group.materialKey + "|normal" + std::to_string(normalMap));
 }
 
 const std::vector<Mesh>& Model::GetMeshes() const
@@ -15,40 +258,398 @@ const std::vector<Mesh>& Model::GetMeshes() const
 
 void Model::loadModel(string path)
 {
+	auto start = std::chrono::steady_clock::now();
+	sourcePath = path;
+	directory = path.substr(0, path.find_last_of('/'));
+
+	if (cache.Open(path, IMPORT_FLAGS, vertexFormat))
+	{
+		fromCache = true;
+		for (const CachedMeshView& view : cache.GetMeshes())
+		{
+			StagedMesh mesh;
+			mesh.buffers = view.buffers;
+			mesh.textures = view.textures;
+			mesh.transparent = view.transparent;
+			mesh.bounds = view.bounds;
+			mesh.node = view.node;
+			mesh.geometry = view.geometry < staged.size() ? view.geometry : static_cast<unsigned int>(staged.size());
+			for (const Texture& texture : mesh.textures)
+			{
+				string filename = textureFilename(texture.path, directory);
+				if (!filename.empty())
+					TextureLoader::Get().Prefetch(filename);
+			}
+			staged.push_back(std::move(mesh));
+		}
+		nodes = cache.GetNodes();
+		importMs = elapsedMs(start);
+		return;
+	}
+
 	Assimp::Importer import;
-	const aiScene * scene = import.ReadFile(path, aiProcess_Triangulate |
-		aiProcess_FlipUVs  /* | aiProcess_CalcTangentSpace*/);
+	const aiScene * scene = import.ReadFile(path, IMPORT_FLAGS);
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
 		!scene->mRootNode)
 	{
 		cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
 		return;
 	}
-	directory = path.substr(0, path.find_last_of('/'));
-	processNode(scene->mRootNode, scene);
+	meshOfAiMesh.assign(scene->mNumMeshes, -1);
+	processNode(scene->mRootNode, scene, SceneGraph::NO_PARENT);
+
+	// Mesh conversion, tangents and optimization are independent per aiMesh.
+	vector<ImportedMesh> imported(aiMeshesToProcess.size());
+	JobPool::Get().ParallelFor(imported.size(), [&](size_t i)
+	{
+		imported[i] = processMesh(scene->mMeshes[aiMeshesToProcess[i]], scene);
+	});
+
+	// Identical geometry and material imported before (a prop copied in the file) shares its
+	// buffers. Decided in mesh order, so the result does not depend on which thread finished first.
+	std::unordered_map<uint64_t, unsigned int> geometryByHash;
+	vector<size_t> toStage;
+	for (size_t i = 0; i < imported.size(); i++)
+	{
+		cout << imported[i].report;
+		ImportedMesh& mesh = imported[i];
+		unsigned int index = static_cast<unsigned int>(meshOfAiMesh[aiMeshesToProcess[i]]);
+		auto same = geometryByHash.find(mesh.hash);
+		if (same != geometryByHash.end())
+		{
+			const ImportedMesh& original = imported[same->second];
+			bool sameTextures = original.textures.size() == mesh.textures.size();
+			for (size_t t = 0; sameTextures && t < mesh.textures.size(); t++)
+				sameTextures = original.textures[t].path == mesh.textures[t].path && original.textures[t].type == mesh.textures[t].type;
+			if (sameTextures && original.transparent == mesh.transparent && original.indices == mesh.indices &&
+				original.vertices.size() == mesh.vertices.size() &&
+				memcmp(original.vertices.data(), mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) == 0)
+			{
+				staged[index].geometry = static_cast<unsigned int>(meshOfAiMesh[aiMeshesToProcess[same->second]]);
+				continue;
+			}
+		}
+		staged[index].geometry = index;
+		geometryByHash.emplace(mesh.hash, static_cast<unsigned int>(i));
+		toStage.push_back(i);
+	}
+	JobPool::Get().ParallelFor(toStage.size(), [&](size_t i)
+	{
+		size_t source = toStage[i];
+		stageMesh(imported[source], staged[meshOfAiMesh[aiMeshesToProcess[source]]]);
+	});
+
+	// A repeated reference still points at the first use of its aiMesh, which may itself be shared.
+	for (size_t i = 0; i < staged.size(); i++)
+		staged[i].geometry = staged[staged[i].geometry].geometry;
+	meshOfAiMesh.clear();
+	aiMeshesToProcess.clear();
+	importMs = elapsedMs(start);
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+bool Model::UploadStep(double budgetMs)
 {
+	if (uploaded)
+		return true;
+	auto start = std::chrono::steady_clock::now();
+	auto finishStep = [&](bool done)
+	{
+		uploadMs += elapsedMs(start);
+		uploadSteps++;
+		return done;
+	};
+
+	// One mesh (its textures and buffers, or its slice of the batch) is the smallest step.
+	const size_t BATCH_CHUNK_BYTES = 4 * 1024 * 1024;
+	while (nextStaged < staged.size())
+	{
+		uploadStaged(staged[nextStaged++]);
+		if (elapsedMs(start) >= budgetMs)
+			return finishStep(false);
+	}
+	while (batch && !batch->UploadStep(BATCH_CHUNK_BYTES))
+	{
+		if (elapsedMs(start) >= budgetMs)
+			return finishStep(false);
+	}
+	finishStep(true);
+	finishUpload();
+	return true;
+}
+
+void Model::uploadStaged(StagedMesh& mesh)
+{
+	// A copy shares the GPU buffers of the mesh it duplicates, but not its CPU-side geometry.
+	if (mesh.geometry < meshes.size())
+	{
+		meshes.push_back(meshes[mesh.geometry].ShareGeometry());
+		meshes.back().node = mesh.node;
+		return;
+	}
+
+	vector<Texture> textures;
+	for (const Texture& ref : mesh.textures)
+		textures.push_back(loadTexture(ref.path, ref.type));
+	if (!mesh.vertexBytes.empty())
+	{
+		mesh.buffers.vertices = mesh.vertexBytes.data();
+		mesh.buffers.indices = mesh.indexBytes.data();
+	}
+	meshes.emplace_back(mesh.buffers, textures, batch.get());
+	Mesh& result = meshes.back();
+	result.transparent = mesh.transparent;
+	result.bounds = mesh.bounds;
+	result.node = mesh.node;
+	result.geometry = static_cast<unsigned int>(meshes.size() - 1);
+	result.vertices = std::move(mesh.vertices);
+	result.indices = std::move(mesh.indices);
+	result.lods = std::move(mesh.lods);
+	vector<unsigned char>().swap(mesh.vertexBytes);
+	vector<unsigned char>().swap(mesh.indexBytes);
+}
+
+void Model::finishUpload()
+{
+	if (uploaded)
+		return;
+	uploaded = true;
+	auto start = std::chrono::steady_clock::now();
+	buildDrawGroups(sourcePath);
+	uploadMs += elapsedMs(start);
+	vector<StagedMesh>().swap(staged);
+
+	double totalMs = importMs + uploadMs;
+	if (fromCache)
+	{
+		cout << "Model " << sourcePath << ": warm load (mesh cache) " << totalMs << " ms (import " << importMs
+			<< " ms, GL upload " << uploadMs << " ms in " << uploadSteps << " steps), cold load (Assimp) was "
+			<< cache.GetColdLoadMs() << " ms";
+		if (totalMs > 0.0)
+			cout << " -> " << cache.GetColdLoadMs() / totalMs << "x faster";
+		cout << endl;
+		cache.Close();
+	}
+	else if (!meshes.empty())
+	{
+		cout << "Model " << sourcePath << ": cold load (Assimp) " << totalMs << " ms (import " << importMs
+			<< " ms on " << JobPool::Get().ThreadCount() + 1 << " threads, GL upload " << uploadMs << " ms in " << uploadSteps << " steps)" << endl;
+	}
+	reportVertexMemory(sourcePath);
+	reportLods(sourcePath);
+	if (!fromCache && !meshes.empty() && !MeshCache::Write(sourcePath, IMPORT_FLAGS, vertexFormat, meshes, nodes, totalMs))
+		cout << "Warning: mesh cache not written for " << sourcePath << endl;
+}
+
+void Model::buildDrawGroups(const string& path)
+{
+	if (meshes.empty())
+		return;
+
+	// Nodes are stored parents first, so one pass accumulates the model-space transforms.
+	vector<glm::mat4> modelSpace(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+		modelSpace[i] = nodes[i].parent == SceneGraph::NO_PARENT ? nodes[i].local : modelSpace[nodes[i].parent] * nodes[i].local;
+	meshTransforms.resize(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++)
+		meshTransforms[i] = meshes[i].node < nodes.size() ? modelSpace[meshes[i].node] : glm::mat4(1.0f);
+
+	// Opaque geometry used by more than one mesh is drawn instanced, one group per geometry.
+	vector<unsigned int> users(meshes.size(), 0);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].geometry >= meshes.size())
+			meshes[i].geometry = i;
+		users[meshes[i].geometry]++;
+	}
+	vector<int> instanceGroupOf(meshes.size(), -1);
+	meshInstanceGroup.assign(meshes.size(), -1);
+	size_t sharedBytes = 0;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		unsigned int geometry = meshes[i].geometry;
+		if (geometry != i)
+			sharedBytes += meshes[i].GpuBytes();
+		if (users[geometry] < 2 || meshes[i].transparent)
+			continue;
+		if (instanceGroupOf[geometry] < 0)
+		{
+			InstanceGroup group;
+			group.mesh = geometry;
+			for (const Texture& texture : meshes[geometry].textures)
+				group.materialKey += std::to_string(texture.id) + texture.type + ";";
+			instanceGroupOf[geometry] = static_cast<int>(instanceGroups.size());
+			instanceGroups.push_back(group);
+		}
+		meshInstanceGroup[i] = instanceGroupOf[geometry];
+		instanceGroups[meshInstanceGroup[i]].members.push_back(i);
+	}
+
+	// Group the rest by texture set (ids and sampler types, in order), blend mode, index type and
+	// model-space transform, in first-use order. allKeys counts the groups there would be without instancing.
+	vector<glm::mat4> transformClasses;
+	std::map<string, size_t> groupOf;
+	std::set<string> allKeys;
+	meshGroup.resize(meshes.size());
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		size_t transformClass = 0;
+		while (transformClass < transformClasses.size() &&
+			memcmp(&transformClasses[transformClass], &meshTransforms[i], sizeof(glm::mat4)) != 0)
+			transformClass++;
+		if (transformClass == transformClasses.size())
+			transformClasses.push_back(meshTransforms[i]);
+
+		string materialKey;
+		for (const Texture& texture : meshes[i].textures)
+			materialKey += std::to_string(texture.id) + texture.type + ";";
+
+		auto it = groupOf.end();
+		if (batch)
+		{
+			const MeshBatch::Range& range = batch->GetRange(meshes[i].GetBatchRange());
+			string key = std::to_string(range.indexType) + "|" + std::to_string(transformClass) +
+				(meshes[i].transparent ? "|blend|" : "|") + materialKey;
+			allKeys.insert(key);
+			if (meshInstanceGroup[i] >= 0)
+				continue;
+			it = groupOf.find(key);
+			if (it == groupOf.end())
+				it = groupOf.emplace(key, drawGroups.size()).first;
+		}
+		else if (meshInstanceGroup[i] >= 0)
+			continue;
+		if (it == groupOf.end() || it->second == drawGroups.size())
+		{
+			DrawGroup group;
+			group.mesh = i;
+			group.node = meshes[i].node;
+			group.materialKey = materialKey;
+			group.transparent = meshes[i].transparent;
+			drawGroups.push_back(group);
+		}
+		meshGroup[i] = batch ? static_cast<unsigned int>(it->second) : static_cast<unsigned int>(drawGroups.size() - 1);
+		if (batch)
+			batch->AddToList(meshes[i].GetBatchRange(), drawGroups[it->second].list);
+	}
+	SetNormalMap(normalMap);
+
+	vector<AABB> boxes;
+	for (size_t i = 0; i < meshes.size(); i++)
+		boxes.push_back(TransformBox(meshes[i].bounds.box, meshTransforms[i]));
+	bvh.Build(boxes);
+
+	if (batch)
+		cout << "Model " << path << ": " << meshes.size() << " meshes in one VAO, " << drawGroups.size()
+			<< " multi-draws per frame (was " << meshes.size() << " VAO binds and draw calls)" << endl;
+	if (!instanceGroups.empty() || sharedBytes)
+	{
+		size_t withoutInstancing = batch ? allKeys.size() : meshes.size();
+		size_t withInstancing = drawGroups.size() + instanceGroups.size();
+		size_t instanced = 0;
+		for (const InstanceGroup& group : instanceGroups)
+			instanced += group.members.size();
+		cout << "Model " << path << ": " << instanced << " meshes drawn as instances of " << instanceGroups.size()
+			<< " geometries, shared buffers save " << sharedBytes / (1024.0 * 1024.0) << " MB, draw calls per frame "
+			<< withoutInstancing << " -> " << withInstancing << endl;
+	}
+}
+
+void Model::reportVertexMemory(const string& path) const
+{
+	size_t fullBytes = 0, gpuBytes = 0;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].geometry != i)
+			continue;
+		fullBytes += meshes[i].FullFormatBytes();
+		gpuBytes += meshes[i].GpuBytes();
+	}
+	if (fullBytes == 0)
+		return;
+	double toMB = 1.0 / (1024.0 * 1024.0);
+	cout << "Model " << path << ": vertex/index VRAM " << fullBytes * toMB << " MB full -> " << gpuBytes * toMB
+		<< " MB " << (vertexFormat == VertexFormat::Packed ? "packed" : "full") << ", saves " << (fullBytes - gpuBytes) * toMB
+		<< " MB" << endl;
+}
+
+void Model::reportLods(const string& path) const
+{
+	// A mesh with a shorter chain counts with its coarsest level.
+	size_t triangles[MAX_LODS] = {};
+	size_t meshesWithLevel[MAX_LODS] = {};
+	for (const Mesh& mesh : meshes)
+	{
+		for (unsigned int lod = 0; lod < MAX_LODS; lod++)
+		{
+			unsigned int level = std::min(lod, mesh.LodCount() - 1);
+			triangles[lod] += mesh.GetLod(level).indexCount / 3;
+			if (level == lod)
+				meshesWithLevel[lod]++;
+		}
+	}
+	if (triangles[0] == 0)
+		return;
+	cout << "Model " << path << ": LOD triangles " << triangles[0];
+	for (unsigned int lod = 1; lod < MAX_LODS; lod++)
+		cout << " -> " << triangles[lod] << " (" << 100.0 * triangles[lod] / triangles[0] << "%, "
+			<< meshesWithLevel[lod] << "/" << meshes.size() << " meshes)";
+	cout << endl;
+}
+
+string Model::optimizeMesh(const string& name, vector<Vertex>& vertices, vector<unsigned int>& indices) const
+{
+	size_t vertexCountBefore = vertices.size();
+	VertexCacheStats before = AnalyzeVertexCache(indices, vertices.size());
+	OptimizeMesh(vertices, indices);
+	VertexCacheStats after = AnalyzeVertexCache(indices, vertices.size());
+
+	std::ostringstream report;
+	report << "Mesh " << (name.empty() ? "<unnamed>" : name) << ": " << after.triangles << " tris, vertices "
+		<< vertexCountBefore << " -> " << vertices.size() << ", ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+	return report.str();
+}
+
+void Model::processNode(aiNode* node, const aiScene* scene, int parent)
+{
+	// aiMatrix4x4 is row-major, glm is column-major.
+	ModelNode modelNode;
+	modelNode.parent = parent;
+	modelNode.local = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+	int index = static_cast<int>(nodes.size());
+	nodes.push_back(modelNode);
+
 	for (unsigned int i = 0; i < node->mNumMeshes; i++)
 	{
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		// A glTF mesh placed by several nodes is imported once and copied.
+		unsigned int aiIndex = node->mMeshes[i];
+		StagedMesh mesh;
+		mesh.node = index;
+		if (meshOfAiMesh[aiIndex] >= 0)
+			mesh.geometry = static_cast<unsigned int>(meshOfAiMesh[aiIndex]);
+		else
+		{
+			meshOfAiMesh[aiIndex] = static_cast<int>(staged.size());
+			aiMeshesToProcess.push_back(aiIndex);
+		}
+		staged.push_back(std::move(mesh));
 	}
 	for (unsigned int i = 0; i < node->mNumChildren; i++)
 	{
-		processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene, index);
 	}
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+Model::ImportedMesh Model::processMesh(aiMesh* mesh, const aiScene* scene) const
 {
 	vector<Vertex> vertices;
 	vector<unsigned int> indices;
 	vector<Texture> textures;
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 	{
-		Vertex vertex;
+		// Value-initialized: the tangent pass accumulates into Tangent/Bitangent and the
+		// optimizer compares vertices bit for bit.
+		Vertex vertex{};
 		glm::vec3 vector;
 		vector.x = mesh->mVertices[i].x;
 		vector.y = mesh->mVertices[i].y;
@@ -106,50 +707,21 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 			indices.push_back(face.mIndices[j]);
 	}
 
-	if (!mesh->HasTangentsAndBitangents()) {
-		for (unsigned int i = 0; i < indices.size(); i += 3) {
-			Vertex& v0 = vertices[indices[i]];
-			Vertex& v1 = vertices[indices[i + 1]];
-			Vertex& v2 = vertices[indices[i + 2]];
+	if (!mesh->HasTangentsAndBitangents())
+		generateTangents(vertices, indices);
 
-			glm::vec3 edge1 = v1.Position - v0.Position;
-			glm::vec3 edge2 = v2.Position - v0.Position;
-			glm::vec2 deltaUV1 = v1.TexCoord - v0.TexCoord;
-			glm::vec2 deltaUV2 = v2.TexCoord - v0.TexCoord;
-
-			float f = (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-			if (fabs(f) > 1e-6f) f = 1.0f / f;
-			else f = 0.0f;
-
-			glm::vec3 tangent, bitangent;
-			tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-			tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-			tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-			bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-			bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-			bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-			v0.Tangent += tangent;
-			v1.Tangent += tangent;
-			v2.Tangent += tangent;
-
-			v0.Bitangent += bitangent;
-			v1.Bitangent += bitangent;
-			v2.Bitangent += bitangent;
-		}
-
-		for (auto& vertex : vertices) {
-			vertex.Tangent = glm::normalize(vertex.Tangent);
-			vertex.Bitangent = glm::normalize(vertex.Bitangent);
-		}
-	}
+	string report = optimizeMesh(mesh->mName.C_Str(), vertices, indices);
 
 	// process material
+	bool transparent = false;
 	if (mesh->mMaterialIndex >= 0)
 	{
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
+		aiString alphaMode;
+		if (material->Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode) == AI_SUCCESS)
+			transparent = string(alphaMode.C_Str()) == "BLEND";
+
 		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
@@ -168,85 +740,111 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 
 	}
 
-	return Mesh(vertices, indices, textures);
+	ImportedMesh result;
+	result.hash = GeometryHash(vertices, indices);
+	result.vertices = std::move(vertices);
+	result.indices = std::move(indices);
+	result.textures = textures;
+	result.transparent = transparent;
+	result.report = report;
+	return result;
 }
 
-unsigned int TextureFromFile(const char* path, const string& directory)
+void Model::stageMesh(ImportedMesh& imported, StagedMesh& mesh) const
 {
-	stbi_set_flip_vertically_on_load(false);
-
-
-	string filename = string(path);
-	filename = directory + '/' + filename;
+	MeshBounds bounds = ComputeBounds(imported.vertices.data(), imported.vertices.size());
+	vector<MeshLod> lods = BuildLodChain(imported.vertices, imported.indices, bounds.sphere.radius);
+
+	mesh.buffers = PackMeshBuffers(imported.vertices, imported.indices, lods, vertexFormat, mesh.vertexBytes, mesh.indexBytes);
+	mesh.textures = imported.textures;
+	mesh.transparent = imported.transparent;
+	mesh.bounds = bounds;
+	mesh.vertices = std::move(imported.vertices);
+	mesh.indices = std::move(imported.indices);
+	mesh.lods = std::move(lods);
+}
 
-	if (filename.find('*') != std::string::npos) {
-		std::cout << "Warning: Embedded textures not supported by this method: " << filename << std::endl;
-		return 0;
+bool Model::BenchmarkTangents(const string& path, int runs)
+{
+	Assimp::Importer import;
+	const aiScene* scene = import.ReadFile(path, IMPORT_FLAGS);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
+		return false;
 	}
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+	// Every mesh of the file in one stream, as processMesh would see them before optimization.
+	TangentStreams streams;
+	vector<unsigned int> indices;
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++)
 	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
+		const aiMesh* mesh = scene->mMeshes[m];
+		size_t base = streams.Size();
+		streams.Resize(base + mesh->mNumVertices);
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+		{
+			streams.px[base + i] = mesh->mVertices[i].x;
+			streams.py[base + i] = mesh->mVertices[i].y;
+			streams.pz[base + i] = mesh->mVertices[i].z;
+			streams.u[base + i] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].x : 0.0f;
+			streams.v[base + i] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].y : 0.0f;
+		}
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+		{
+			for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+				indices.push_back(static_cast<unsigned int>(base + mesh->mFaces[i].mIndices[j]));
+		}
 	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+	cout << "Model " << path << ": " << scene->mNumMeshes << " meshes, " << streams.Size() * sizeof(Vertex) / (1024.0 * 1024.0)
+		<< " MB as Vertex structs" << endl;
+	return BenchmarkTangentKernels(streams, indices, runs);
+}
+
+unsigned int TextureFromFile(const char* path, const string& directory)
+{
+	string filename = textureFilename(path, directory);
+	if (filename.empty()) {
+		std::cout << "Warning: Embedded textures not supported by this method: " << directory << '/' << path << std::endl;
+		return 0;
 	}
 
-	return textureID;
+	// Decoded on the TextureLoader pool (usually prefetched during the import), uploaded when the
+	// GL thread calls UploadReady().
+	return TextureLoader::Get().Request(filename);
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) const
 {
 	vector<Texture>textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString str;
 		mat->GetTexture(type, i, &str);
-		bool skip = false;
-		for (unsigned int j = 0; j < textures_loaded.size(); j++)
-		{
-			if (std::strcmp(textures_loaded[j].path.data(),
-				str.C_Str()) == 0)
-			{
-				textures.push_back(textures_loaded[j]);
-				skip = true;
-				break;
-			}
-		}
-		if (!skip)
-		{
-			Texture texture;
-			texture.id = TextureFromFile(str.C_Str(), directory);
-			texture.type = typeName;
-			texture.path = str.C_Str();
-			textures.push_back(texture);
-			textures_loaded.push_back(texture);
-		}
+		Texture texture;
+		texture.id = 0;
+		texture.type = typeName;
+		texture.path = str.C_Str();
+		textures.push_back(texture);
+		// Start decoding while the rest of the scene is still being imported.
+		string filename = textureFilename(texture.path, directory);
+		if (!filename.empty())
+			TextureLoader::Get().Prefetch(filename);
 	}
 	return textures;
+}
+
+Texture Model::loadTexture(const string& path, const string& typeName)
+{
+	for (unsigned int j = 0; j < textures_loaded.size(); j++)
+	{
+		if (textures_loaded[j].path == path)
+			return textures_loaded[j];
+	}
+	Texture texture;
+	texture.id = TextureFromFile(path.c_str(), directory);
+	texture.type = typeName;
+	texture.path = path;
+	textures_loaded.push_back(texture);
+	return texture;
 }
\ No newline at end of file
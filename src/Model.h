@@ -8,27 +8,193 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <unordered_map>
 #include "Mesh.h"
+#include "MeshBatch.h"
+#include "MeshCache.h"
+#include "RenderQueue.h"
+#include "Culling.h"
+#include "SceneGraph.h"
+#include "LodSelection.h"
 #include <Shader.h>
 
 class Model
 {
 public:
-	explicit Model(const std::string& path)
+	// sharedBuffers packs every mesh into one MeshBatch and draws each material with a single multi-draw.
+	explicit Model(const std::string& path, VertexFormat format = VertexFormat::Packed, bool sharedBuffers = true)
+		: Model(path, format, sharedBuffers, ImportOnly())
 	{
-		loadModel(path);
+		UploadStep(std::numeric_limits<double>::infinity());
+	}
+	// The CPU half of loading (mesh cache or Assimp import, optimization, LODs) without a single GL
+	// call, so it can run on any thread. The model is unusable until UploadStep returns true.
+	static std::unique_ptr<Model> Import(const std::string& path, VertexFormat format = VertexFormat::Packed, bool sharedBuffers = true)
+	{
+		return std::unique_ptr<Model>(new Model(path, format, sharedBuffers, ImportOnly()));
 	}
+	// GL thread only. Creates textures and buffers mesh by mesh, then the batch buffers in chunks,
+	// for at least one step and until budgetMs is spent. Returns true once the model can be drawn.
+	bool UploadStep(double budgetMs);
+	bool IsUploaded() const { return uploaded; }
+	// Immediate draw with whatever model matrix the caller has set; node transforms are not applied.
 	void Draw(Shader& shader);
+	// Adds an instance root (identity) under parent with the file's node hierarchy beneath it and
+	// returns the root. Setting the root's local matrix places the whole model. Calling it again
+	// (same graph) adds another copy; every copy is culled and LOD-selected on its own.
+	int AttachTo(SceneGraph& graph, int parent = SceneGraph::NO_PARENT);
+	// Frustum-culls the meshes of every copy through the model's BVH, picks each visible mesh's LOD
+	// from its projected error and queues one command per copy and draw group with anything visible
+	// plus one instanced draw per shared geometry and LOD across all copies, using the graph's world
+	// matrices (call SceneGraph::Update first). The queue must be executed before the model is modified.
+	void Submit(RenderQueue& queue, Shader& shader, CullStats& cullStats, LodStats& lodStats);
+	// Submit for a depth-only pass (the queue's view is the light's): opaque meshes only, always at
+	// LOD 0, all under one material since the depth program samples no textures. Camera LOD state is left alone.
+	void SubmitShadowCasters(RenderQueue& queue, Shader& depthShader, CullStats& cullStats);
+	// World-space box around every mesh of every copy, from the graph's current matrices.
+	AABB WorldBounds() const;
+	// World-space box of the one copy whose root AttachTo returned.
+	AABB WorldBounds(int rootNode) const;
+	// Normal map bound to texture unit 1 before the mesh textures of every submitted draw (0 unbinds it).
+	void SetNormalMap(unsigned int texture);
 	const std::vector<Mesh>& GetMeshes() const;
+	// Imports path with Assimp and times every tangent kernel on all of its meshes (see
+	// BenchmarkTangentKernels). Returns false if the file does not load or a kernel disagrees.
+	static bool BenchmarkTangents(const string& path, int runs);
+	// Mesh transform relative to the model root, from the file's node hierarchy.
+	const glm::mat4& GetMeshTransform(unsigned int mesh) const { return meshTransforms[mesh]; }
 private:
+	struct ImportOnly {};
+	Model(const std::string& path, VertexFormat format, bool sharedBuffers, ImportOnly)
+		: vertexFormat(format)
+	{
+		if (sharedBuffers)
+			batch = std::make_unique<MeshBatch>(format);
+		loadModel(path);
+	}
+
+	// A mesh imported off the GL thread, waiting for UploadStep to become a Mesh. The bytes back
+	// buffers unless they point into the open mesh cache; vertices, indices and lods are only kept
+	// after an Assimp import, for the cache write. A copy (geometry below its own index) carries
+	// nothing but its node.
+	struct StagedMesh {
+		MeshBuffers buffers;
+		vector<unsigned char> vertexBytes, indexBytes;
+		vector<Texture> textures;   // id == 0, resolved by UploadStep
+		bool transparent = false;
+		MeshBounds bounds = {};
+		unsigned int node = 0;
+		unsigned int geometry = 0;
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+		vector<MeshLod> lods;
+	};
+
+	// processMesh output for one aiMesh, before identical geometry is shared and LODs are built.
+	struct ImportedMesh {
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+		vector<Texture> textures;   // id == 0
+		bool transparent = false;
+		uint64_t hash = 0;
+		string report;              // optimizer statistics, printed in mesh order
+	};
+
 	vector<Mesh> meshes;
 	string directory;
 	vector<Texture>textures_loaded;
+	VertexFormat vertexFormat;
+	vector<ModelNode> nodes;
+	vector<glm::mat4> meshTransforms;
+	SceneGraph* graph = nullptr;
+
+	// Meshes sharing a texture set, blend mode, index type and model-space transform, drawn as one
+	// glMultiDrawElementsBaseVertex with the world matrix of node. Node transforms below the root are
+	// treated as rigid. Without a batch every mesh is its own group and list stays empty.
+	struct DrawGroup {
+		unsigned int mesh;
+		unsigned int node;
+		MultiDrawList list;
+		string materialKey;
+		bool transparent;
+		uint16_t material;
+	};
+	// Rebuilt by Submit from the meshes of one copy that survive culling, one per draw group.
+	struct GroupVisibility {
+		MultiDrawList visible;
+		unsigned int visibleMeshes;
+		float nearestDepth;
+	};
+	// One copy of the model in the graph (see AttachTo).
+	struct Attachment {
+		int rootNode;
+		int firstNode;
+		vector<GroupVisibility> groups;
+		// Level each mesh was last drawn at, the starting point for the hysteresis.
+		vector<unsigned char> meshLod;
+	};
+	// Meshes sharing one geometry (see Mesh::geometry) at different nodes, drawn with one instanced
+	// draw per LOD. Transparent meshes are never instanced, so they keep their back-to-front order.
+	struct InstanceGroup {
+		unsigned int mesh;
+		vector<unsigned int> members;
+		string materialKey;
+		uint16_t material;
+		// Rebuilt by Submit: world matrices of the visible members, by LOD.
+		vector<glm::mat4> instances[MAX_LODS];
+		float nearestDepth;
+	};
+	std::unique_ptr<MeshBatch> batch;
+	vector<DrawGroup> drawGroups;
+	vector<InstanceGroup> instanceGroups;
+	vector<unsigned int> meshGroup;
+	// Instance group of each mesh, -1 for meshes drawn through drawGroups.
+	vector<int> meshInstanceGroup;
+	BoundsBVH bvh;
+	vector<unsigned int> visibleMeshes;
+	vector<int> nodeTransforms;
+	vector<Attachment> attachments;
+	unsigned int normalMap = 0;
+
+	// Import only: staged index of each aiMesh's first use, and the aiMeshes to process, in that order.
+	vector<int> meshOfAiMesh;
+	vector<unsigned int> aiMeshesToProcess;
+
+	// Import to upload hand-over.
+	string sourcePath;
+	MeshCache cache;             // stays mapped while staged buffers point into it
+	bool fromCache = false;
+	vector<StagedMesh> staged;
+	size_t nextStaged = 0;
+	double importMs = 0.0;
+	double uploadMs = 0.0;
+	unsigned int uploadSteps = 0;
+	bool uploaded = false;
 
 	void loadModel(string path);
-	void processNode(aiNode* node, const aiScene* scene);
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-	vector<Texture> loadMaterialTextures(aiMaterial* mat,aiTextureType type, string typeName);
+	// Collects the nodes and a placeholder staged mesh per mesh reference; no mesh data yet.
+	void processNode(aiNode* node, const aiScene* scene, int parent);
+	// Runs on the JobPool, one call per aiMesh: touches nothing but its arguments.
+	ImportedMesh processMesh(aiMesh* mesh, const aiScene* scene) const;
+	// Bounds, LOD chain and packed buffers for a mesh that keeps its own geometry. JobPool too.
+	void stageMesh(ImportedMesh& imported, StagedMesh& mesh) const;
+	// Dedup + vertex cache / overdraw / fetch reordering; returns ACMR and ATVR before and after.
+	string optimizeMesh(const string& name, vector<Vertex>& vertices, vector<unsigned int>& indices) const;
+	// Texture references only (id 0), their decode prefetched; UploadStep requests the names on the GL thread.
+	vector<Texture> loadMaterialTextures(aiMaterial* mat,aiTextureType type, string typeName) const;
+	Texture loadTexture(const string& path, const string& typeName);
+	void reportVertexMemory(const string& path) const;
+	void reportLods(const string& path) const;
+	void buildDrawGroups(const string& path);
+	// GL thread: turns staged[index] into meshes[index].
+	void uploadStaged(StagedMesh& mesh);
+	// GL thread, after the last upload step: draw groups, reports and the cache write.
+	void finishUpload();
+	// Both Submit variants; lodStats == nullptr submits shadow casters.
+	void submit(RenderQueue& queue, Shader& shader, CullStats& cullStats, LodStats* lodStats);
 };
 
 #endif
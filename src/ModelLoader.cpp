@@ -0,0 +1,118 @@
+#include "ModelLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+ModelLoader& ModelLoader::Get()
+{
+    // A handful of large models: two imports at a time are plenty and leave the cores to the
+    // texture decoders, which the imports feed through TextureLoader::Prefetch as they read materials.
+    unsigned int cores = std::thread::hardware_concurrency();
+    static ModelLoader loader(std::min(2u, cores > 1 ? cores - 1 : 1));
+    return loader;
+}
+
+ModelLoader::ModelLoader(unsigned int threadCount)
+{
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&ModelLoader::workerLoop, this);
+}
+
+ModelLoader::~ModelLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+ModelHandle ModelLoader::Load(const std::string& path, VertexFormat format, bool sharedBuffers)
+{
+    ModelHandle handle;
+    handle.slot = std::make_shared<Slot>();
+    handle.slot->path = path;
+    handle.slot->format = format;
+    handle.slot->sharedBuffers = sharedBuffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(handle.slot);
+        pending++;
+    }
+    jobReady.notify_one();
+    return handle;
+}
+
+void ModelLoader::workerLoop()
+{
+    for (;;) {
+        std::shared_ptr<Slot> slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            slot = jobs.front();
+            jobs.pop_front();
+        }
+
+        // Only the worker touches slot->model until it is handed over below.
+        slot->model = Model::Import(slot->path, slot->format, slot->sharedBuffers);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            imported.push_back(slot);
+        }
+        modelImported.notify_one();
+    }
+}
+
+size_t ModelLoader::Update(double budgetMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uploading.insert(uploading.end(), imported.begin(), imported.end());
+        imported.clear();
+    }
+
+    // Oldest request first, so models appear one after another instead of all at the end.
+    size_t finished = 0;
+    double remainingMs = budgetMs;
+    while (!uploading.empty()) {
+        std::shared_ptr<Slot> slot = uploading.front();
+        if (slot->model->UploadStep(remainingMs)) {
+            slot->ready = true;
+            uploading.pop_front();
+            finished++;
+        }
+        remainingMs = budgetMs - std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (remainingMs <= 0.0)
+            break;
+    }
+
+    if (finished > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending -= finished;
+    }
+    return finished;
+}
+
+void ModelLoader::Finish()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending == 0) return;
+            if (uploading.empty())
+                modelImported.wait(lock, [this] { return !imported.empty(); });
+        }
+        Update(std::numeric_limits<double>::infinity());
+    }
+}
+
+size_t ModelLoader::Pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending;
+}
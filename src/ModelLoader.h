@@ -0,0 +1,73 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Model.h"
+
+// A model requested from ModelLoader. Get() stays null until the model is fully uploaded, so
+// the frame loop can keep drawing whatever is already there and place the model when it appears.
+class ModelHandle {
+public:
+    ModelHandle() = default;
+
+    bool Ready() const { return slot && slot->ready; }
+    Model* Get() const { return Ready() ? slot->model.get() : nullptr; }
+    const std::string& Path() const { return slot->path; }
+
+private:
+    friend class ModelLoader;
+    struct Slot {
+        std::string path;
+        VertexFormat format;
+        bool sharedBuffers;
+        std::unique_ptr<Model> model;
+        bool ready = false;      // GL thread only
+    };
+    std::shared_ptr<Slot> slot;
+};
+
+// Imports models (mesh cache or Assimp, optimization, LODs) on worker threads and uploads them on
+// the GL thread a few meshes at a time under a per-frame budget, next to the texture uploads of
+// TextureLoader. The window shows its first frame before any model has finished loading.
+class ModelLoader {
+public:
+    static ModelLoader& Get();
+
+    explicit ModelLoader(unsigned int threadCount);
+    ~ModelLoader();
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    ModelHandle Load(const std::string& path, VertexFormat format = VertexFormat::Packed, bool sharedBuffers = true);
+    // GL thread only. Uploads imported models, at least one step and until budgetMs is spent, and
+    // returns how many became ready.
+    size_t Update(double budgetMs);
+    // GL thread only. Blocks until every requested model is ready.
+    void Finish();
+    size_t Pending() const;
+
+private:
+    using Slot = ModelHandle::Slot;
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable modelImported;
+    std::deque<std::shared_ptr<Slot>> jobs;
+    std::deque<std::shared_ptr<Slot>> imported;
+    size_t pending = 0;
+    bool stopping = false;
+
+    // GL thread only, in request order.
+    std::deque<std::shared_ptr<Slot>> uploading;
+};
+
+#endif
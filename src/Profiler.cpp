@@ -0,0 +1,270 @@
+#include "Profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+void appendJsonString(std::string& out, const char* text)
+{
+    out += '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            out += '\\';
+        out += *c;
+    }
+    out += '"';
+}
+
+void appendTraceEvent(std::string& out, const char* name, const char* category, int thread, double begin, double duration)
+{
+    char numbers[96];
+    std::snprintf(numbers, sizeof(numbers), ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", thread, begin, duration);
+    out += out.empty() ? "[\n{\"name\":" : ",\n{\"name\":";
+    appendJsonString(out, name);
+    out += ",\"cat\":\"";
+    out += category;
+    out += '"';
+    out += numbers;
+}
+
+// min, avg and p99 of the first count entries of a ring, count <= ring size.
+void summarize(const std::vector<float>& ring, size_t count, float& minimum, float& average, float& p99)
+{
+    std::vector<float> samples(ring.begin(), ring.begin() + count);
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (float sample : samples)
+        sum += sample;
+    minimum = samples.front();
+    average = static_cast<float>(sum / samples.size());
+    size_t rank = (samples.size() * 99 + 99) / 100;
+    p99 = samples[std::max<size_t>(rank, 1) - 1];
+}
+
+}
+
+Profiler& Profiler::Get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : start(std::chrono::steady_clock::now())
+{
+}
+
+double Profiler::now() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int Profiler::nodeFor(const char* name, int parent)
+{
+    auto found = nodeIds.find({ parent, name });
+    if (found != nodeIds.end())
+        return found->second;
+
+    Node node;
+    node.name = name;
+    node.parent = parent;
+    node.depth = parent < 0 ? 0 : nodes[parent].depth + 1;
+    nodes.push_back(node);
+    int id = static_cast<int>(nodes.size()) - 1;
+    nodeIds[{ parent, name }] = id;
+    return id;
+}
+
+void Profiler::BeginFrame()
+{
+    if (inFrame)
+        EndFrame();
+
+    // The slot was last used FRAME_LATENCY frames ago; its queries are usually done by now.
+    current = (current + 1) % FRAME_LATENCY;
+    Frame& frame = frames[current];
+    if (frame.pending)
+        resolve(frame);
+    frame.events.clear();
+    frame.queriesUsed = 0;
+    frame.pending = false;
+
+    inFrame = true;
+    open.clear();
+    Push("Frame", true);
+}
+
+void Profiler::EndFrame()
+{
+    if (!inFrame)
+        return;
+    while (!open.empty())
+        Pop();
+    inFrame = false;
+    frames[current].pending = true;
+}
+
+void Profiler::Push(const char* name, bool gpu)
+{
+    if (!inFrame)
+        return;
+
+    Frame& frame = frames[current];
+    int parent = open.empty() ? -1 : frame.events[open.back()].node;
+    Event event;
+    event.node = nodeFor(name, parent);
+    event.cpuBegin = now();
+    event.cpuEnd = event.cpuBegin;
+    event.query = -1;
+    if (gpu) {
+        nodes[event.node].gpu = true;
+        while (frame.queries.size() < frame.queriesUsed + 2) {
+            GLuint query = 0;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+        // The end timestamp goes into the next query, reserved now so nested scopes come after it.
+        event.query = static_cast<int>(frame.queriesUsed);
+        frame.queriesUsed += 2;
+        glQueryCounter(frame.queries[event.query], GL_TIMESTAMP);
+    }
+    frame.events.push_back(event);
+    open.push_back(static_cast<int>(frame.events.size()) - 1);
+}
+
+void Profiler::Pop()
+{
+    if (!inFrame || open.empty())
+        return;
+
+    Frame& frame = frames[current];
+    Event& event = frame.events[open.back()];
+    open.pop_back();
+    if (event.query >= 0)
+        glQueryCounter(frame.queries[event.query + 1], GL_TIMESTAMP);
+    event.cpuEnd = now();
+}
+
+void Profiler::resolve(Frame& frame)
+{
+    frame.pending = false;
+
+    // Queries finish in order, so the root's end timestamp (written last) covers them all.
+    bool gpuReady = false;
+    if (frame.queriesUsed > 0 && !frame.events.empty() && frame.events[0].query >= 0) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame.queries[frame.events[0].query + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        gpuReady = available != 0;
+    }
+    std::vector<GLuint64> timestamps;
+    if (gpuReady) {
+        timestamps.resize(frame.queriesUsed);
+        for (size_t i = 0; i < frame.queriesUsed; i++)
+            glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+
+    // A scope may run several times per frame (one per model, say); its sample is the frame's total.
+    std::vector<double> cpuTotal(nodes.size(), 0.0), gpuTotal(nodes.size(), 0.0);
+    std::vector<char> seen(nodes.size(), 0);
+    for (const Event& event : frame.events) {
+        seen[event.node] = 1;
+        cpuTotal[event.node] += (event.cpuEnd - event.cpuBegin) / 1000.0;
+        if (gpuReady && event.query >= 0)
+            gpuTotal[event.node] += (timestamps[event.query + 1] - timestamps[event.query]) / 1.0e6;
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!seen[i])
+            continue;
+        Node& node = nodes[i];
+        if (node.cpuMs.empty())
+            node.cpuMs.resize(HISTORY);
+        node.cpuMs[node.cpuSamples++ % HISTORY] = static_cast<float>(cpuTotal[i]);
+        if (gpuReady && node.gpu) {
+            if (node.gpuMs.empty())
+                node.gpuMs.resize(HISTORY);
+            node.gpuMs[node.gpuSamples++ % HISTORY] = static_cast<float>(gpuTotal[i]);
+        }
+    }
+
+    if (traceFramesLeft == 0)
+        return;
+    // GPU events go on their own track, placed relative to the frame's CPU start.
+    const double frameBegin = frame.events[0].cpuBegin;
+    for (const Event& event : frame.events) {
+        appendTraceEvent(trace, nodes[event.node].name, "cpu", 1, event.cpuBegin, event.cpuEnd - event.cpuBegin);
+        if (gpuReady && event.query >= 0) {
+            double begin = frameBegin + (timestamps[event.query] - timestamps[frame.events[0].query]) / 1000.0;
+            double duration = (timestamps[event.query + 1] - timestamps[event.query]) / 1000.0;
+            appendTraceEvent(trace, nodes[event.node].name, "gpu", 2, begin, duration);
+        }
+    }
+    traceFrames++;
+    if (--traceFramesLeft == 0)
+        writeTrace();
+}
+
+void Profiler::CaptureTrace(const std::string& path, unsigned int frameCount)
+{
+    if (traceFramesLeft > 0) {
+        std::cout << "Profiler: a trace is already being captured to " << tracePath << std::endl;
+        return;
+    }
+    tracePath = path;
+    trace.clear();
+    traceFrames = 0;
+    traceFramesLeft = frameCount;
+    std::cout << "Profiler: capturing " << frameCount << " frames to " << path << std::endl;
+}
+
+void Profiler::writeTrace()
+{
+    std::ofstream file(tracePath, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::PROFILER::CANNOT_WRITE_TRACE " << tracePath << std::endl;
+        return;
+    }
+    file << trace;
+    file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}";
+    file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}\n]\n";
+    trace.clear();
+    std::cout << "Profiler: wrote " << traceFrames << " frames to " << tracePath << std::endl;
+}
+
+void Profiler::PrintSummary() const
+{
+    // Children follow their parent in first-seen order.
+    std::vector<std::vector<int>> children(nodes.size() + 1);
+    for (size_t i = 0; i < nodes.size(); i++)
+        children[nodes[i].parent + 1].push_back(static_cast<int>(i));
+
+    std::cout << "Profiler, last " << HISTORY << " frames (ms)       cpu min/avg/p99          gpu min/avg/p99" << std::endl;
+    std::vector<int> stack(children[0].rbegin(), children[0].rend());
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        int id = stack.back();
+        stack.pop_back();
+        stack.insert(stack.end(), children[id + 1].rbegin(), children[id + 1].rend());
+        if (node.cpuSamples == 0)
+            continue;
+
+        float minimum, average, p99;
+        char line[160];
+        std::string label = std::string(node.depth * 2, ' ') + node.name;
+        summarize(node.cpuMs, std::min(node.cpuSamples, HISTORY), minimum, average, p99);
+        std::snprintf(line, sizeof(line), "%-32s %7.3f %7.3f %7.3f", label.c_str(), minimum, average, p99);
+        std::cout << line;
+        if (node.gpuSamples > 0) {
+            summarize(node.gpuMs, std::min(node.gpuSamples, HISTORY), minimum, average, p99);
+            std::snprintf(line, sizeof(line), "    %7.3f %7.3f %7.3f", minimum, average, p99);
+            std::cout << line;
+        }
+        std::cout << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Hierarchical frame profiler. PROFILE_SCOPE times the rest of the enclosing block on the CPU,
+// PROFILE_GPU_SCOPE additionally brackets the GL commands issued in it with GL_TIMESTAMP queries.
+// Scopes nest; every frame (PROFILE_BEGIN_FRAME .. PROFILE_END_FRAME) is one tree rooted at "Frame".
+// Query results are read FRAME_LATENCY frames later and only if the driver already has them, so
+// the profiler never waits on the GPU. Without ENABLE_PROFILER every macro expands to nothing.
+#ifdef ENABLE_PROFILER
+
+#include <glad/glad.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Profiler {
+public:
+    static const int FRAME_LATENCY = 4;    // frames in flight before their queries are read
+    static const size_t HISTORY = 240;     // samples per scope kept for the summary
+
+    static Profiler& Get();
+
+    Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void BeginFrame();
+    void EndFrame();
+    // Scopes opened outside a frame are ignored. name must stay valid for the program's lifetime.
+    void Push(const char* name, bool gpu);
+    void Pop();
+
+    // min/avg/p99 of every scope over its last HISTORY frames, as an indented tree.
+    void PrintSummary() const;
+    // Writes the next frameCount complete frames to path as a Chrome trace (chrome://tracing, Perfetto).
+    void CaptureTrace(const std::string& path, unsigned int frameCount);
+
+private:
+    struct NameLess {
+        bool operator()(const std::pair<int, const char*>& a, const std::pair<int, const char*>& b) const
+        {
+            return a.first != b.first ? a.first < b.first : std::strcmp(a.second, b.second) < 0;
+        }
+    };
+
+    // One scope of the tree, shared by every frame that opens it under the same parent.
+    struct Node {
+        const char* name;
+        int parent;
+        int depth;
+        bool gpu = false;
+        std::vector<float> cpuMs, gpuMs;   // rings of HISTORY samples
+        size_t cpuSamples = 0, gpuSamples = 0;
+    };
+
+    struct Event {
+        int node;
+        double cpuBegin, cpuEnd;           // microseconds since the profiler started
+        int query;                         // begin timestamp query, end is the next one; -1 for CPU only
+    };
+
+    struct Frame {
+        std::vector<Event> events;
+        std::vector<GLuint> queries;       // grows to the most timestamps any frame issued in this slot
+        size_t queriesUsed = 0;
+        bool pending = false;
+    };
+
+    std::chrono::steady_clock::time_point start;
+    std::vector<Node> nodes;
+    std::map<std::pair<int, const char*>, int, NameLess> nodeIds;
+    Frame frames[FRAME_LATENCY];
+    int current = 0;
+    bool inFrame = false;
+    std::vector<int> open;                 // indices into the current frame's events
+
+    std::string tracePath;
+    std::string trace;
+    unsigned int traceFramesLeft = 0;
+    unsigned int traceFrames = 0;
+
+    double now() const;
+    int nodeFor(const char* name, int parent);
+    void resolve(Frame& frame);
+    void writeTrace();
+};
+
+class ProfileScope {
+public:
+    ProfileScope(const char* name, bool gpu) { Profiler::Get().Push(name, gpu); }
+    ~ProfileScope() { Profiler::Get().Pop(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, false)
+#define PROFILE_GPU_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, true)
+#define PROFILE_BEGIN_FRAME() Profiler::Get().BeginFrame()
+#define PROFILE_END_FRAME() Profiler::Get().EndFrame()
+#define PROFILE_PRINT_SUMMARY() Profiler::Get().PrintSummary()
+#define PROFILE_CAPTURE_TRACE(path, frameCount) Profiler::Get().CaptureTrace(path, frameCount)
+
+#else
+
+#define PROFILE_SCOPE(name) do {} while (0)
+#define PROFILE_GPU_SCOPE(name) do {} while (0)
+#define PROFILE_BEGIN_FRAME() do {} while (0)
+#define PROFILE_END_FRAME() do {} while (0)
+#define PROFILE_PRINT_SUMMARY() do {} while (0)
+#define PROFILE_CAPTURE_TRACE(path, frameCount) do {} while (0)
+
+#endif
+
+#endif
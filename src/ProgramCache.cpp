@@ -0,0 +1,212 @@
+#include "ProgramCache.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Not in the GL 3.3 headers glad was generated for.
+const GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+const GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+const GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+GetProgramBinaryProc getProgramBinary = nullptr;
+ProgramBinaryProc programBinary = nullptr;
+ProgramParameteriProc programParameteri = nullptr;
+
+const char MAGIC[4] = { 'P', 'R', 'G', 'B' };
+const char* CACHE_DIRECTORY = "shader_cache";
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+    uint32_t driverLength;
+    uint32_t reserved;
+};
+
+bool hasExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+std::string glString(GLenum name)
+{
+    const char* value = reinterpret_cast<const char*>(glGetString(name));
+    return value ? value : "";
+}
+
+void fnv1a(uint64_t& hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+} // namespace
+
+ProgramCache& ProgramCache::Get()
+{
+    static ProgramCache cache;
+    return cache;
+}
+
+void ProgramCache::Initialize(GLADloadproc load)
+{
+    driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+    binaryFormats = 0;
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1) || hasExtension("GL_ARB_get_program_binary")) {
+        getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+        programBinary = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+        programParameteri = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+        if (getProgramBinary && programBinary && programParameteri)
+            glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    }
+
+    // The KHR and ARB extensions share their enums; 0xFFFFFFFF lets the driver pick the thread count.
+    MaxShaderCompilerThreadsProc maxThreads = nullptr;
+    if (hasExtension("GL_KHR_parallel_shader_compile"))
+        maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR"));
+    else if (hasExtension("GL_ARB_parallel_shader_compile"))
+        maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsARB"));
+    parallelCompile = maxThreads != nullptr;
+    if (maxThreads)
+        maxThreads(0xFFFFFFFFu);
+
+    std::cout << "Program binary cache: " << (BinariesSupported() ? "on" : "unsupported")
+        << ", parallel shader compile: " << (parallelCompile ? "on" : "unsupported") << std::endl;
+}
+
+uint64_t ProgramCache::Key(const std::string& vertexSource, const std::string& fragmentSource) const
+{
+    uint64_t hash = 14695981039346656037ull;
+    const char separator = '\0';
+    fnv1a(hash, vertexSource.data(), vertexSource.size());
+    fnv1a(hash, &separator, 1);
+    fnv1a(hash, fragmentSource.data(), fragmentSource.size());
+    fnv1a(hash, &separator, 1);
+    fnv1a(hash, driver.data(), driver.size());
+    return hash;
+}
+
+std::string ProgramCache::pathFor(uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return std::string(CACHE_DIRECTORY) + "/" + name;
+}
+
+bool ProgramCache::Load(uint64_t key, GLuint program)
+{
+    if (!BinariesSupported()) {
+        misses++;
+        return false;
+    }
+
+    MappedFile file;
+    CacheHeader header;
+    if (!file.Open(pathFor(key)) || file.Size() < sizeof(CacheHeader)) {
+        misses++;
+        return false;
+    }
+    std::memcpy(&header, file.Data(), sizeof(header));
+    const unsigned char* driverName = file.Data() + sizeof(CacheHeader);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION ||
+        header.key != key ||
+        uint64_t(sizeof(CacheHeader)) + header.driverLength + header.binaryLength != file.Size() ||
+        std::string(reinterpret_cast<const char*>(driverName), header.driverLength) != driver)
+    {
+        misses++;
+        return false;
+    }
+
+    // The driver may still refuse a binary it wrote (e.g. after an update that kept the version
+    // string); the program is then left unlinked and gets built from source.
+    programBinary(program, header.binaryFormat, driverName + header.driverLength, static_cast<GLsizei>(header.binaryLength));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        misses++;
+        return false;
+    }
+    hits++;
+    return true;
+}
+
+void ProgramCache::PrepareLink(GLuint program) const
+{
+    if (BinariesSupported())
+        programParameteri(program, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::Store(uint64_t key, GLuint program)
+{
+    if (!BinariesSupported())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    getProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+    CacheHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binaryLength = static_cast<uint32_t>(written);
+    header.driverLength = static_cast<uint32_t>(driver.size());
+    header.reserved = 0;
+
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIRECTORY, ec);
+    const std::string cachePath = pathFor(key);
+    const std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << tempPath << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(driver.data(), driver.size());
+        out.write(binary.data(), written);
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << tempPath << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec)
+        std::remove(tempPath.c_str());
+}
@@ -0,0 +1,48 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (GL 4.1 / ARB_get_program_binary), one file per program
+// in shader_cache/, keyed by the preprocessed sources and the driver's vendor/renderer/version
+// string. Also switches on KHR/ARB_parallel_shader_compile, which lets glCompileShader and
+// glLinkProgram return at once so the programs of a batch build side by side until their status
+// is queried (Shader::Finish). Both are optional: without Initialize(), or on a driver without
+// them, Load() always misses, Store() does nothing and programs build one after another.
+class ProgramCache {
+public:
+    static const uint32_t VERSION = 1;
+
+    static ProgramCache& Get();
+
+    // Resolves the entry points glad (GL 3.3) does not load. Needs a current context.
+    void Initialize(GLADloadproc load);
+
+    bool BinariesSupported() const { return binaryFormats > 0; }
+    bool ParallelCompile() const { return parallelCompile; }
+
+    uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource) const;
+    // Loads the binary stored under key into program; false (program left unlinked) on a miss,
+    // a stale file or a driver that rejects it.
+    bool Load(uint64_t key, GLuint program);
+    // Call before glLinkProgram so the driver keeps the binary around for Store().
+    void PrepareLink(GLuint program) const;
+    void Store(uint64_t key, GLuint program);
+
+    // Programs loaded from a binary, and programs that had to be built from source.
+    unsigned int Hits() const { return hits; }
+    unsigned int Misses() const { return misses; }
+
+private:
+    ProgramCache() = default;
+    std::string pathFor(uint64_t key) const;
+
+    GLint binaryFormats = 0;
+    bool parallelCompile = false;
+    std::string driver;
+    unsigned int hits = 0, misses = 0;
+};
+
+#endif
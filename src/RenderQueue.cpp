@@ -0,0 +1,266 @@
+#include "RenderQueue.h"
+#include <algorithm>
+
+namespace {
+
+const int DEPTH_BITS = 24;
+const uint64_t DEPTH_MAX = (uint64_t(1) << DEPTH_BITS) - 1;
+
+}
+
+RenderQueue::~RenderQueue()
+{
+    if (instanceBuffer)
+        glDeleteBuffers(1, &instanceBuffer);
+}
+
+uint16_t RenderQueue::MaterialId(const std::string& key)
+{
+    static std::unordered_map<std::string, uint16_t> ids;
+    auto it = ids.find(key);
+    if (it != ids.end())
+        return it->second;
+    uint16_t id = static_cast<uint16_t>(ids.size());
+    ids.emplace(key, id);
+    return id;
+}
+
+uint64_t RenderQueue::MakeKey(Layer layer, unsigned int program, uint16_t material, float depth01)
+{
+    uint64_t depth = static_cast<uint64_t>(std::min(std::max(depth01, 0.0f), 1.0f) * DEPTH_MAX);
+    uint64_t programBits = program & 0xFFFF;
+    if (layer == Opaque)
+        return (programBits << 47) | (uint64_t(material) << 31) | (depth << 7);
+    return (uint64_t(1) << 63) | ((DEPTH_MAX - depth) << 39) | (programBits << 23) | (uint64_t(material) << 7);
+}
+
+void RenderQueue::Begin(const glm::mat4& view, const glm::mat4& projection, float maxDepth, float viewportHeight)
+{
+    this->view = view;
+    viewProjection = projection * view;
+    this->maxDepth = maxDepth;
+    // projection[1][1] = cot(fovY / 2): a unit at depth 1 covers half of it in NDC height.
+    pixelScale = projection[1][1] * viewportHeight * 0.5f;
+    commands.clear();
+    transforms.clear();
+    instances.clear();
+}
+
+uint32_t RenderQueue::AddTransform(const glm::mat4& transform)
+{
+    transforms.push_back(transform);
+    return static_cast<uint32_t>(transforms.size() - 1);
+}
+
+float RenderQueue::ViewDepth(const glm::vec3& worldPosition) const
+{
+    return -(view * glm::vec4(worldPosition, 1.0f)).z;
+}
+
+void RenderQueue::Submit(Layer layer, Shader& shader, uint16_t material, float viewDepth, Mesh& mesh,
+    const MultiDrawList* list, unsigned int normalMap, uint32_t transform, unsigned int lod)
+{
+    DrawCommand command;
+    command.key = MakeKey(layer, shader.ID, material, viewDepth / maxDepth);
+    command.shader = &shader;
+    command.mesh = &mesh;
+    command.material = material;
+    command.list = list;
+    command.normalMap = normalMap;
+    command.transform = transform;
+    command.lod = lod;
+    command.firstInstance = 0;
+    command.instanceCount = 0;
+    commands.push_back(command);
+}
+
+uint32_t RenderQueue::AddInstances(const glm::mat4* matrices, size_t count)
+{
+    uint32_t first = static_cast<uint32_t>(instances.size());
+    instances.insert(instances.end(), matrices, matrices + count);
+    return first;
+}
+
+void RenderQueue::SubmitInstanced(Layer layer, Shader& shader, uint16_t material, float viewDepth, Mesh& mesh, unsigned int lod,
+    unsigned int normalMap, uint32_t firstInstance, uint32_t instanceCount)
+{
+    DrawCommand command;
+    command.key = MakeKey(layer, shader.ID, material, viewDepth / maxDepth);
+    command.shader = &shader;
+    command.mesh = &mesh;
+    command.material = material;
+    command.list = nullptr;
+    command.normalMap = normalMap;
+    command.transform = 0;
+    command.lod = lod;
+    command.firstInstance = firstInstance;
+    command.instanceCount = instanceCount;
+    commands.push_back(command);
+}
+
+void RenderQueue::sortCommands()
+{
+    size_t count = commands.size();
+    keys.resize(count);
+    order.resize(count);
+    keysScratch.resize(count);
+    orderScratch.resize(count);
+
+    size_t histogram[8][256] = {};
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = commands[i].key;
+        order[i] = static_cast<uint32_t>(i);
+        for (int b = 0; b < 8; b++)
+            histogram[b][(keys[i] >> (b * 8)) & 0xFF]++;
+    }
+
+    // LSD radix sort on 8-bit digits; stable, so equal keys keep submission order.
+    for (int b = 0; b < 8; b++) {
+        size_t* bucket = histogram[b];
+        if (bucket[(keys[0] >> (b * 8)) & 0xFF] == count)
+            continue; // every key has the same digit here
+
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++) {
+            size_t n = bucket[d];
+            bucket[d] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t slot = bucket[(keys[i] >> (b * 8)) & 0xFF]++;
+            keysScratch[slot] = keys[i];
+            orderScratch[slot] = order[i];
+        }
+        keys.swap(keysScratch);
+        order.swap(orderScratch);
+    }
+}
+
+void RenderQueue::Execute()
+{
+    Prepare();
+    ExecuteLayer(Opaque);
+    ExecuteLayer(Transparent);
+}
+
+void RenderQueue::Prepare()
+{
+    stats = Stats();
+    stats.commands = commands.size();
+    transparentStart = 0;
+    if (commands.empty())
+        return;
+
+    sortCommands();
+
+    // Opaque keys have the top bit clear, so the sorted order is every opaque command, then every transparent one.
+    const uint64_t layerBit = uint64_t(1) << 63;
+    transparentStart = std::partition_point(keys.begin(), keys.end(),
+        [layerBit](uint64_t key) { return (key & layerBit) == 0; }) - keys.begin();
+
+    if (!instances.empty()) {
+        if (!instanceBuffer)
+            glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::mat4), instances.data(), GL_STREAM_DRAW);
+    }
+}
+
+void RenderQueue::ExecuteLayer(Layer layer, Shader* replacement)
+{
+    size_t first = layer == Opaque ? 0 : transparentStart;
+    size_t last = layer == Opaque ? transparentStart : commands.size();
+    if (first == last)
+        return;
+
+    Shader* currentShader = nullptr;
+    int currentMaterial = -1;
+    uint32_t currentTransform = ~0u;
+    const MeshBatch* currentBatch = nullptr;
+    ProgramUniforms uniforms;
+    int instancedMode = -1;   // value of the current program's "instanced", -1 when unknown
+    bool blending = layer == Transparent;
+
+    if (blending) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+    }
+
+    for (size_t i = first; i < last; i++) {
+        const DrawCommand& command = commands[order[i]];
+        Shader* shader = replacement ? replacement : command.shader;
+
+        if (shader != currentShader) {
+            currentShader = shader;
+            currentShader->use();
+            auto it = programUniforms.find(currentShader->ID);
+            if (it == programUniforms.end()) {
+                ProgramUniforms lookup;
+                lookup.model = currentShader->getUniform<glm::mat4>("model");
+                lookup.instanced = currentShader->getUniform<bool>("instanced");
+                it = programUniforms.emplace(currentShader->ID, lookup).first;
+            }
+            uniforms = it->second;
+            currentMaterial = -1;
+            currentTransform = ~0u;
+            instancedMode = -1;
+            stats.programChanges++;
+        }
+
+        bool instanced = command.instanceCount > 0;
+        if (static_cast<int>(instanced) != instancedMode) {
+            currentShader->set(uniforms.instanced, instanced);
+            instancedMode = instanced;
+        }
+        if (!instanced && command.transform != currentTransform) {
+            currentShader->set(uniforms.model, transforms[command.transform]);
+            currentTransform = command.transform;
+        }
+
+        if (command.material != currentMaterial) {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, command.normalMap);
+            command.mesh->BindTextures(*currentShader);
+            currentMaterial = command.material;
+            stats.materialChanges++;
+        }
+
+        if (instanced) {
+            const MeshBatch* batch = command.mesh->GetBatch();
+            if (!batch || batch != currentBatch) {
+                command.mesh->BindVertexArray();
+                currentBatch = batch;
+                stats.vaoBinds++;
+            }
+            // The instance attributes are VAO state, so they are pointed at this draw's matrices and
+            // switched off again for the non-instanced draws that share the VAO.
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            SetupInstanceAttributes(command.firstInstance * sizeof(glm::mat4));
+            command.mesh->DrawInstanced(command.lod, command.instanceCount);
+            DisableInstanceAttributes();
+            stats.instancedDraws++;
+            stats.instances += command.instanceCount;
+        }
+        else if (command.list) {
+            const MeshBatch* batch = command.mesh->GetBatch();
+            if (batch != currentBatch) {
+                batch->Bind();
+                currentBatch = batch;
+                stats.vaoBinds++;
+            }
+            batch->Draw(*command.list);
+        }
+        else {
+            command.mesh->DrawGeometry(command.lod);
+            currentBatch = nullptr;
+            stats.vaoBinds++;
+        }
+    }
+
+    glBindVertexArray(0);
+    if (blending) {
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Mesh.h"
+#include "MeshBatch.h"
+
+// One draw submitted to the RenderQueue. list == nullptr draws the mesh on its own, otherwise the
+// list is submitted as one multi-draw from the mesh's batch (textures still come from mesh).
+struct DrawCommand {
+    uint64_t key;
+    Shader* shader;
+    Mesh* mesh;
+    uint16_t material;        // RenderQueue::MaterialId of the mesh textures + normalMap
+    const MultiDrawList* list;
+    unsigned int normalMap;   // bound to texture unit 1 before the mesh textures (0 unbinds it)
+    uint32_t transform;
+    unsigned int lod;         // level drawn when list == nullptr
+    // instanceCount > 0 draws the mesh instanced with RenderQueue instance matrices
+    // [firstInstance, firstInstance + instanceCount) instead of transform.
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+// Collects the frame's draws, radix-sorts them by a 64-bit state key and executes them with
+// redundant program, texture, transform and VAO changes skipped.
+//
+// Key layout, most significant bit first:
+//   opaque:      [63] 0 | [62..47] program | [46..31] material | [30..7] depth, near first
+//   transparent: [63] 1 | [62..39] depth, far first | [38..23] program | [22..7] material
+class RenderQueue {
+public:
+    enum Layer { Opaque = 0, Transparent = 1 };
+
+    struct Stats {
+        size_t commands = 0;
+        size_t programChanges = 0;
+        size_t materialChanges = 0;
+        size_t vaoBinds = 0;
+        size_t instancedDraws = 0;
+        size_t instances = 0;
+    };
+
+    RenderQueue() = default;
+    ~RenderQueue();
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    // Material ids are shared by all queues; key is any string that identifies the texture set.
+    // Commands with the same id must bind the same textures.
+    static uint16_t MaterialId(const std::string& key);
+    static uint64_t MakeKey(Layer layer, unsigned int program, uint16_t material, float depth01);
+
+    // Starts a frame. Depths are view-space distances, quantized over [0, maxDepth].
+    void Begin(const glm::mat4& view, const glm::mat4& projection, float maxDepth, float viewportHeight);
+    // projection * view of the current frame, for culling submitted objects.
+    const glm::mat4& ViewProjection() const { return viewProjection; }
+    uint32_t AddTransform(const glm::mat4& transform);
+    float ViewDepth(const glm::vec3& worldPosition) const;
+    // Height in pixels of a world-space length seen face-on at viewDepth.
+    float ProjectedSize(float worldSize, float viewDepth) const { return worldSize * pixelScale / viewDepth; }
+    void Submit(Layer layer, Shader& shader, uint16_t material, float viewDepth, Mesh& mesh,
+        const MultiDrawList* list, unsigned int normalMap, uint32_t transform, unsigned int lod = 0);
+    // World matrices for an instanced draw; returns the index of the first one.
+    uint32_t AddInstances(const glm::mat4* matrices, size_t count);
+    void SubmitInstanced(Layer layer, Shader& shader, uint16_t material, float viewDepth, Mesh& mesh, unsigned int lod,
+        unsigned int normalMap, uint32_t firstInstance, uint32_t instanceCount);
+    void Execute();
+    // Execute() in steps, for passes in between the layers: Prepare() sorts and uploads once, then
+    // each ExecuteLayer() draws one layer. replacement, when set, draws every command of the layer
+    // with that program instead of its own (it must read the same vertex inputs and samplers).
+    void Prepare();
+    void ExecuteLayer(Layer layer, Shader* replacement = nullptr);
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    float maxDepth = 1.0f;
+    float pixelScale = 1.0f;
+    std::vector<DrawCommand> commands;
+    std::vector<glm::mat4> transforms;
+    // Uploaded once per Execute into instanceBuffer.
+    std::vector<glm::mat4> instances;
+    unsigned int instanceBuffer = 0;
+
+    // "model" and "instanced" of each program the queue has drawn with.
+    struct ProgramUniforms {
+        Uniform<glm::mat4> model;
+        Uniform<bool> instanced;
+    };
+    std::unordered_map<unsigned int, ProgramUniforms> programUniforms;
+    Stats stats;
+
+    // Radix sort scratch, kept between frames.
+    std::vector<uint64_t> keys, keysScratch;
+    std::vector<uint32_t> order, orderScratch;
+    size_t transparentStart = 0;   // first transparent command in order
+
+    void sortCommands();
+};
+
+#endif
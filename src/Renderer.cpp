@@ -1,13 +1,94 @@
 #include "Renderer.h"
+#include "ProgramCache.h"
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 const unsigned int SCR_WIDTH = 1300;
 const unsigned int SCR_HEIGHT = 900;
 
+namespace {
+
+bool glfwActive = false;
+
+// load is the loader glad was initialized with, for the entry points glad does not cover.
+void setDefaultState(GLADloadproc load)
+{
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    ProgramCache::Get().Initialize(load);
+}
+
+#ifdef HEADLESS_EGL
+EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+EGLContext eglContext = EGL_NO_CONTEXT;
+
+bool initializeEGL()
+{
+    EGLint major, minor;
+    EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    // Surfaceless needs neither X11 nor Wayland; the default display is the fallback.
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            std::cout << "Failed to initialize EGL" << std::endl;
+            return false;
+        }
+    }
+
+    const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = NULL;
+    EGLint configCount = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, configCount ? config : NULL, EGL_NO_CONTEXT, contextAttributes);
+    // No surface at all: everything is drawn into framebuffer objects.
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "Failed to create an EGL OpenGL 3.3 context (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    eglDisplay = display;
+    eglContext = context;
+    return true;
+}
+#endif
+
+}
+
 GLFWwindow* Renderer::Initialize() {
     if (!glfwInit()) {
         std::cout << "Failed to initialize GLFW" << std::endl;
         return nullptr;
     }
+    glfwActive = true;
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -17,6 +98,7 @@ GLFWwindow* Renderer::Initialize() {
     if (!window) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
+        glfwActive = false;
         return nullptr;
     }
 
@@ -30,9 +112,7 @@ GLFWwindow* Renderer::Initialize() {
         return nullptr;
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    setDefaultState((GLADloadproc)glfwGetProcAddress);
 
     // NOWE: Blokowanie kursora w oknie
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -40,3 +120,54 @@ GLFWwindow* Renderer::Initialize() {
 
     return window;
 }
+
+bool Renderer::InitializeHeadless(GLFWwindow*& window) {
+    window = nullptr;
+    if (glfwInit()) {
+        glfwActive = true;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        window = glfwCreateWindow(64, 64, "Model Loader (headless)", NULL, NULL);
+        if (window) {
+            glfwMakeContextCurrent(window);
+            if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+                setDefaultState((GLADloadproc)glfwGetProcAddress);
+                return true;
+            }
+            glfwDestroyWindow(window);
+            window = nullptr;
+        }
+        glfwTerminate();
+        glfwActive = false;
+    }
+
+#ifdef HEADLESS_EGL
+    // No display (render nodes, CI): fall back to EGL.
+    if (initializeEGL()) {
+        setDefaultState((GLADloadproc)eglGetProcAddress);
+        return true;
+    }
+#endif
+
+    std::cout << "Failed to create a headless OpenGL context" << std::endl;
+    return false;
+}
+
+void Renderer::Shutdown() {
+#ifdef HEADLESS_EGL
+    if (eglDisplay != EGL_NO_DISPLAY) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+        eglDisplay = EGL_NO_DISPLAY;
+        eglContext = EGL_NO_CONTEXT;
+    }
+#endif
+    if (glfwActive) {
+        glfwTerminate();
+        glfwActive = false;
+    }
+}
@@ -8,6 +8,12 @@
 class Renderer {
 public:
     static GLFWwindow* Initialize();
+    // Context for offscreen rendering, without input or a visible window: a hidden GLFW window
+    // when a display is available, otherwise an EGL surfaceless context (render nodes and CI on
+    // Mesa llvmpipe, builds with HEADLESS_EGL). window is nullptr in the EGL case. The default
+    // framebuffer is not usable either way; draw into an OffscreenTarget.
+    static bool InitializeHeadless(GLFWwindow*& window);
+    static void Shutdown();
 };
 
 // Deklaracja funkcji obsugi myszy
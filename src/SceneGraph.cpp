@@ -0,0 +1,54 @@
+#include "SceneGraph.h"
+#include <iostream>
+
+int SceneGraph::AddNode(int parent, const glm::mat4& local)
+{
+    int node = static_cast<int>(parents.size());
+    if (parent >= node) {
+        std::cout << "ERROR::SCENE_GRAPH::Parent " << parent << " must be added before node " << node << std::endl;
+        parent = NO_PARENT;
+    }
+    parents.push_back(parent);
+    locals.push_back(local);
+    worlds.push_back(local);
+    dirty.push_back(0);
+    markDirty(node);
+    return node;
+}
+
+void SceneGraph::SetLocal(int node, const glm::mat4& local)
+{
+    locals[node] = local;
+    markDirty(node);
+}
+
+void SceneGraph::markDirty(int node)
+{
+    dirty[node] = 1;
+    if (!anyDirty || static_cast<size_t>(node) < firstDirty)
+        firstDirty = node;
+    anyDirty = true;
+}
+
+size_t SceneGraph::Update()
+{
+    if (!anyDirty)
+        return 0;
+
+    // Parents come first, so one forward pass sees a parent's flag before any of its children.
+    size_t updated = 0;
+    for (size_t i = firstDirty; i < parents.size(); i++) {
+        int parent = parents[i];
+        if (parent != NO_PARENT && dirty[parent])
+            dirty[i] = 1;
+        if (!dirty[i])
+            continue;
+        worlds[i] = parent == NO_PARENT ? locals[i] : worlds[parent] * locals[i];
+        updated++;
+    }
+    for (size_t i = firstDirty; i < dirty.size(); i++)
+        dirty[i] = 0;
+
+    anyDirty = false;
+    return updated;
+}
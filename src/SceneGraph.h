@@ -0,0 +1,45 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// A model's node hierarchy as loaded from the file (aiNode::mTransformation), in depth-first order
+// so every parent precedes its children.
+struct ModelNode {
+    int parent;          // index into the same array, -1 for the root
+    glm::mat4 local;
+};
+
+// Transform hierarchy stored as flat arrays in topological order (parents before children).
+// SetLocal only marks the node dirty; Update walks forward from the first dirty node and
+// recomputes world matrices for dirty nodes and their descendants, nothing else.
+class SceneGraph {
+public:
+    static const int NO_PARENT = -1;
+
+    // parent must already exist, which keeps the arrays topologically sorted.
+    int AddNode(int parent, const glm::mat4& local);
+    void SetLocal(int node, const glm::mat4& local);
+
+    // Returns the number of world matrices recomputed.
+    size_t Update();
+
+    const glm::mat4& GetLocal(int node) const { return locals[node]; }
+    const glm::mat4& GetWorld(int node) const { return worlds[node]; }
+    int GetParent(int node) const { return parents[node]; }
+    size_t Size() const { return parents.size(); }
+
+private:
+    std::vector<int> parents;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<unsigned char> dirty;
+    size_t firstDirty = 0;
+    bool anyDirty = false;
+
+    void markDirty(int node);
+};
+
+#endif
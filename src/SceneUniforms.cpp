@@ -0,0 +1,40 @@
+#include "SceneUniforms.h"
+#include <cstddef>
+#include <iostream>
+
+static_assert(sizeof(FrameUniforms) == 160, "FrameUniforms must match the std140 FrameData block");
+static_assert(sizeof(LightUniforms) == 224, "LightUniforms must match the std140 LightData block");
+
+SceneUniforms::SceneUniforms()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0 && offsetof(SceneUniformData, lights) % alignment != 0)
+        std::cout << "ERROR::UNIFORM_BUFFER::LightData offset is not a multiple of " << alignment << std::endl;
+
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(SceneUniformData), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BINDING, UBO, offsetof(SceneUniformData, frame), sizeof(FrameUniforms));
+    glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BINDING, UBO, offsetof(SceneUniformData, lights), sizeof(LightUniforms));
+}
+
+SceneUniforms::~SceneUniforms()
+{
+    glDeleteBuffers(1, &UBO);
+}
+
+void SceneUniforms::Attach(const Shader& shader) const
+{
+    shader.bindUniformBlock("FrameData", FRAME_BINDING);
+    shader.bindUniformBlock("LightData", LIGHT_BINDING);
+}
+
+void SceneUniforms::Upload(const SceneUniformData& data) const
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SceneUniformData), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,61 @@
+#ifndef SCENE_UNIFORMS_H
+#define SCENE_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+
+// CPU mirrors of the std140 blocks in shadersGLSL/uniform_blocks.glsl. Every vec3 is followed by a
+// scalar so the C++ and std140 layouts match member for member.
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float fogDensity;
+    glm::vec3 fogColor;
+    float padding;
+};
+
+struct LightUniforms {
+    glm::vec3 lightDir;
+    float padding0;
+    glm::vec3 lightColor;
+    float padding1;
+    glm::vec3 ambientColor;
+    float padding2;
+    // Filled by LightClusters::FillUniforms.
+    glm::uvec4 clusterGrid;     // tiles x, tiles y, depth slices, light count
+    glm::vec4 clusterParams;    // slice = log(depth) * x + y; z, w = 1 / viewport size
+    // Filled by ShadowMaps::FillUniforms.
+    glm::mat4 staticShadowMatrix;   // world to static shadow map texture space
+    glm::mat4 dynamicShadowMatrix;
+    glm::vec4 shadowBias;           // x, y: normal offset in world units; z, w: depth bias (static, dynamic)
+};
+
+// Both blocks in one struct so a frame costs a single glBufferSubData. 256 bytes covers
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT on every driver we target; the constructor checks it.
+struct SceneUniformData {
+    FrameUniforms frame;
+    alignas(256) LightUniforms lights;
+};
+
+// One uniform buffer shared by every program: FrameData is bound at FRAME_BINDING and LightData
+// at LIGHT_BINDING, so programs only need Attach() once after linking.
+class SceneUniforms {
+public:
+    static const GLuint FRAME_BINDING = 0;
+    static const GLuint LIGHT_BINDING = 1;
+
+    SceneUniforms();
+    ~SceneUniforms();
+    SceneUniforms(const SceneUniforms&) = delete;
+    SceneUniforms& operator=(const SceneUniforms&) = delete;
+
+    void Attach(const Shader& shader) const;
+    void Upload(const SceneUniformData& data) const;
+
+private:
+    unsigned int UBO;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include "ProgramCache.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -7,72 +8,212 @@
 #include <glm/gtc/type_ptr.hpp>
 
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath)
+// Reads a shader file and splices in `#include "file"` lines, resolved next to the including file.
+static std::string readShaderFile(const std::string& path)
+{
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    file.open(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    file.close();
+
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::istringstream lines(stream.str());
+    std::string line, source;
+    while (std::getline(lines, line))
+    {
+        size_t first = line.find_first_not_of(" \t");
+        if (first != std::string::npos && line.compare(first, 8, "#include") == 0)
+        {
+            size_t open = line.find('"', first);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close != std::string::npos)
+            {
+                source += readShaderFile(directory + line.substr(open + 1, close - open - 1));
+                continue;
+            }
+        }
+        source += line;
+        source += '\n';
+    }
+    return source;
+}
+
+// GLSL wants #version first, so the defines go right after it.
+static std::string addDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+    if (defines.empty())
+        return source;
+    std::string block;
+    for (const std::string& define : defines)
+        block += "#define " + define + "\n";
+    size_t version = source.find("#version");
+    if (version == std::string::npos)
+        return block + source;
+    size_t lineEnd = source.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return source + "\n" + block;
+    return source.substr(0, lineEnd + 1) + block + source.substr(lineEnd + 1);
+}
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string>& defines, bool deferLink)
 {
     std::string vertexCode;
     std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
 
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     try
     {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        vShaderFile.close();
-        fShaderFile.close();
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        vertexCode = addDefines(readShaderFile(vertexPath), defines);
+        fragmentCode = addDefines(readShaderFile(fragmentPath), defines);
     }
     catch (std::ifstream::failure &e)
     {
         std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
     }
 
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
+    ProgramCache& cache = ProgramCache::Get();
+    cacheKey = cache.Key(vertexCode, fragmentCode);
+    ID = glCreateProgram();
+    pending = true;
+    if (cache.Load(cacheKey, ID))
+    {
+        fromCache = true;
+    }
+    else
+    {
+        // A binary the driver rejected may have left the program in a failed state; start over.
+        glDeleteProgram(ID);
+        ID = glCreateProgram();
 
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
+        const char *vShaderCode = vertexCode.c_str();
+        const char *fShaderCode = fragmentCode.c_str();
 
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        // No status queries here: with parallel compile those are what would wait for the driver.
+        vertexStage = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertexStage, 1, &vShaderCode, NULL);
+        glCompileShader(vertexStage);
+
+        fragmentStage = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentStage, 1, &fShaderCode, NULL);
+        glCompileShader(fragmentStage);
+
+        glAttachShader(ID, vertexStage);
+        glAttachShader(ID, fragmentStage);
+        cache.PrepareLink(ID);
+        glLinkProgram(ID);
     }
 
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success)
+    if (!deferLink)
+        Finish();
+}
+
+void Shader::Finish()
+{
+    if (!pending)
+        return;
+    pending = false;
+
+    int success;
+    char infoLog[512];
+    if (vertexStage)
     {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderiv(vertexStage, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(vertexStage, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        glGetShaderiv(fragmentStage, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(fragmentStage, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
     }
 
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
     glGetProgramiv(ID, GL_LINK_STATUS, &success);
     if (!success)
     {
         glGetProgramInfoLog(ID, 512, NULL, infoLog);
         std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
+    else if (!fromCache)
+    {
+        ProgramCache::Get().Store(cacheKey, ID);
+    }
+
+    if (vertexStage)
+    {
+        glDeleteShader(vertexStage);
+        glDeleteShader(fragmentStage);
+        vertexStage = fragmentStage = 0;
+    }
+
+    reflectUniforms();
+}
+
+Shader::LookupCounters& Shader::Counters()
+{
+    static LookupCounters counters;
+    return counters;
+}
+
+void Shader::ResetLookupCounters()
+{
+    Counters() = LookupCounters();
+}
+
+void Shader::reflectUniforms()
+{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName = name.substr(0, length);
+        GLint location = glGetUniformLocation(ID, uniformName.c_str());
+        Counters().driver++;
+        if (location < 0)
+            continue; // lives in a uniform block
+
+        // Arrays are reported as "name[0]"; register the bare name and every element.
+        size_t bracket = uniformName.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+        {
+            std::string base = uniformName.substr(0, bracket);
+            uniformLocations[base] = location;
+            for (GLint element = 0; element < size; element++)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                Counters().driver++;
+            }
+        }
+        else
+        {
+            uniformLocations[uniformName] = location;
+        }
+    }
+}
+
+void Shader::bindUniformBlock(const std::string& name, GLuint binding) const
+{
+    GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, index, binding);
+}
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+GLint Shader::getUniformLocation(const std::string& name) const
+{
+    Counters().byName++;
+    auto it = uniformLocations.find(name);
+    return it != uniformLocations.end() ? it->second : -1;
 }
 
 void Shader::use() const
@@ -82,64 +223,118 @@ void Shader::use() const
 
 void Shader::setBool(const std::string &name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(getUniformLocation(name), (int)value);
 }
 
 void Shader::setInt(const std::string &name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(getUniformLocation(name), value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(getUniformLocation(name), value);
 }
 
 void Shader::setVec2(const std::string& name, const glm::vec2& value) const
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(getUniformLocation(name), 1, &value[0]);
 }
 
 void Shader::setVec2(const std::string& name, float x, float y) const
 {
     
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    glUniform2f(getUniformLocation(name), x, y);
     
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(getUniformLocation(name), 1, &value[0]);
 }
 
 void Shader::setVec3(const std::string& name, float x, float y, float z) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(getUniformLocation(name), x, y, z);
 }
 
 void Shader::setVec4(const std::string& name, const glm::vec4& value) const
 {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform4fv(getUniformLocation(name), 1, &value[0]);
 }
 
 void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    glUniform4f(getUniformLocation(name), x, y, z, w);
 }
 
 void Shader::setMat2(const std::string& name, const glm::mat2& mat) const
 {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::setMat3(const std::string& name, const glm::mat3& mat) const
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const
+{
+    Counters().byHandle++;
+    glUniform1i(uniform.location, (int)value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) const
+{
+    Counters().byHandle++;
+    glUniform1i(uniform.location, value);
+}
+
+void Shader::set(Uniform<float> uniform, float value) const
+{
+    Counters().byHandle++;
+    glUniform1f(uniform.location, value);
+}
+
+void Shader::set(Uniform<glm::vec2> uniform, const glm::vec2& value) const
+{
+    Counters().byHandle++;
+    glUniform2fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+    Counters().byHandle++;
+    glUniform3fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+{
+    Counters().byHandle++;
+    glUniform4fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const
+{
+    Counters().byHandle++;
+    glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const
+{
+    Counters().byHandle++;
+    glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+{
+    Counters().byHandle++;
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::checkCompileErrors(GLuint shader, std::string type)
@@ -4,17 +4,63 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Location of one active uniform, resolved once and reused every frame.
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;
+};
+
 class Shader
 {
 public:
+    // Uniform lookups since the last ResetLookupCounters(): by name through the reflected table
+    // (each one used to be a glGetUniformLocation call), through handles, and real driver queries.
+    struct LookupCounters
+    {
+        unsigned int byName = 0;
+        unsigned int byHandle = 0;
+        unsigned int driver = 0;
+    };
+    static LookupCounters& Counters();
+    static void ResetLookupCounters();
+
     unsigned int ID;
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // Each name in defines becomes a `#define NAME` line right after the #version line of both stages.
+    // The program comes from the ProgramCache when it has a binary for these sources, and is built
+    // from them otherwise. With deferLink the status checks and reflection wait for Finish(), so a
+    // batch of programs can compile in parallel (KHR_parallel_shader_compile) before the first one
+    // is finished; the program must not be used before that.
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {}, bool deferLink = false);
+    void Finish();
+    bool FromCache() const { return fromCache; }
     void use() const;
+
+    // Binds the named uniform block to a binding point; no-op if the program does not use it.
+    void bindUniformBlock(const std::string& name, GLuint binding) const;
+
+    GLint getUniformLocation(const std::string& name) const;
+    template <typename T>
+    Uniform<T> getUniform(const std::string& name) const { return Uniform<T>{ getUniformLocation(name) }; }
+
+    void set(Uniform<bool> uniform, bool value) const;
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const;
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+    void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const;
+    void set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const;
+    void set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const;
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
     void setFloat(const std::string& name, float value) const;
@@ -29,6 +75,13 @@ public:
     void setMat4(const std::string& name, const glm::mat4& mat) const;
 
 private:
+    std::unordered_map<std::string, GLint> uniformLocations;
+    uint64_t cacheKey = 0;
+    GLuint vertexStage = 0, fragmentStage = 0;
+    bool pending = false;
+    bool fromCache = false;
+
+    void reflectUniforms();
     void checkCompileErrors(GLuint shader, std::string type);
 };
 #endif
\ No newline at end of file
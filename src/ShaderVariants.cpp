@@ -0,0 +1,71 @@
+#include "ShaderVariants.h"
+#include <chrono>
+#include <iostream>
+
+unsigned int ShaderKey(bool phong, bool bumpMapping, bool fog)
+{
+    unsigned int key = 0;
+    if (phong)
+        key |= SHADER_PHONG;
+    if (phong && bumpMapping)
+        key |= SHADER_BUMP_MAPPING;
+    if (fog)
+        key |= SHADER_FOG;
+    return key;
+}
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, unsigned int features, Setup setup)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), features(features), setup(std::move(setup))
+{
+}
+
+std::vector<std::string> ShaderVariants::Defines(unsigned int key)
+{
+    std::vector<std::string> defines;
+    if (key & SHADER_PHONG)
+        defines.push_back("SHADING_PHONG");
+    if (key & SHADER_BUMP_MAPPING)
+        defines.push_back("BUMP_MAPPING");
+    if (key & SHADER_FOG)
+        defines.push_back("FOG");
+    return defines;
+}
+
+Shader& ShaderVariants::Get(unsigned int key)
+{
+    key &= features;
+    auto found = programs.find(key);
+    if (found != programs.end())
+        return *found->second;
+    Prepare({ key });
+    return *programs[key];
+}
+
+void ShaderVariants::Prepare(const std::vector<unsigned int>& keys)
+{
+    // Start every missing variant before finishing any, so the driver can build them side by side.
+    auto start = std::chrono::steady_clock::now();
+    std::vector<unsigned int> started;
+    for (unsigned int key : keys) {
+        key &= features;
+        if (programs.count(key))
+            continue;
+        std::vector<std::string> defines = Defines(key);
+        programs[key] = std::make_unique<Shader>(vertexPath.c_str(), fragmentPath.c_str(), defines, true);
+        started.push_back(key);
+    }
+
+    for (unsigned int key : started) {
+        Shader& shader = *programs[key];
+        shader.Finish();
+        if (setup)
+            setup(shader);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<std::string> defines = Defines(key);
+        std::cout << "Shader variant " << fragmentPath << " [";
+        for (size_t i = 0; i < defines.size(); i++)
+            std::cout << (i ? " " : "") << defines[i];
+        std::cout << "] " << (shader.FromCache() ? "loaded from cache" : "compiled") << " after " << ms << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Shader.h"
+
+// Permutation key bits of the scene programs, each one a #define in the GLSL sources.
+enum ShaderFeature : unsigned int {
+    SHADER_PHONG = 1 << 0,          // SHADING_PHONG: per-fragment lighting, else Gouraud in the vertex shader
+    SHADER_BUMP_MAPPING = 1 << 1,   // BUMP_MAPPING: normals from the normal map through the TBN
+    SHADER_FOG = 1 << 2,            // FOG: exponential fog from FrameData
+};
+
+// Key for the current toggles. Bump mapping only changes per-fragment normals, so Gouraud keys drop it.
+unsigned int ShaderKey(bool phong, bool bumpMapping, bool fog);
+
+// One vertex/fragment source pair compiled once per permutation key, on first use or in Prepare(),
+// and kept for the rest of the run, so switching variants is just a different program in the
+// render queue.
+class ShaderVariants {
+public:
+    // Called once on every new program: uniform blocks, sampler units and the like.
+    using Setup = std::function<void(Shader&)>;
+
+    // features are the bits these sources look at; the others are masked out of the key so
+    // variants that would compile to the same program share one.
+    ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, unsigned int features, Setup setup);
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    Shader& Get(unsigned int key);
+    // Builds every variant of keys not built yet as one batch (see Shader's deferLink), so startup
+    // can pay for all the variants it will switch between at once instead of one per toggle.
+    void Prepare(const std::vector<unsigned int>& keys);
+    size_t Compiled() const { return programs.size(); }
+
+    static std::vector<std::string> Defines(unsigned int key);
+
+private:
+    std::string vertexPath, fragmentPath;
+    unsigned int features;
+    Setup setup;
+    std::map<unsigned int, std::unique_ptr<Shader>> programs;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "ShadowMaps.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+// Orthographic light view looking along direction from a fixed origin, so texel rows stay put
+// while the fitted box moves.
+glm::mat4 lightView(const glm::vec3& direction)
+{
+    glm::vec3 forward = glm::normalize(direction);
+    glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::lookAt(-forward, glm::vec3(0.0f), up);
+}
+
+// [-1, 1] clip space to [0, 1] texture space.
+const glm::mat4 TEXTURE_BIAS = glm::mat4(
+    0.5f, 0.0f, 0.0f, 0.0f,
+    0.0f, 0.5f, 0.0f, 0.0f,
+    0.0f, 0.0f, 0.5f, 0.0f,
+    0.5f, 0.5f, 0.5f, 1.0f);
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+ShadowMaps::ShadowMaps()
+{
+    createLayer(staticLayer, STATIC_SIZE);
+    createLayer(dynamicLayer, DYNAMIC_SIZE);
+}
+
+ShadowMaps::~ShadowMaps()
+{
+    deleteLayer(staticLayer);
+    deleteLayer(dynamicLayer);
+}
+
+void ShadowMaps::createLayer(Layer& layer, int size)
+{
+    layer.size = size;
+    glGenTextures(1, &layer.depthTexture);
+    glBindTexture(GL_TEXTURE_2D, layer.depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    // Linear filtering on a comparison sampler gives 2x2 PCF for free.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    const float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &layer.FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, layer.FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, layer.depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER::Shadow map of " << size << " is not complete" << std::endl;
+    // Cleared to the far plane: nothing is shadowed until a pass has run.
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMaps::deleteLayer(Layer& layer)
+{
+    glDeleteFramebuffers(1, &layer.FBO);
+    glDeleteTextures(1, &layer.depthTexture);
+    layer.FBO = layer.depthTexture = 0;
+}
+
+bool ShadowMaps::NeedsStaticUpdate(const glm::vec3& lightDirection) const
+{
+    if (!staticValid)
+        return true;
+    return glm::dot(glm::normalize(lightDirection), staticDirection) < 0.99999f;
+}
+
+void ShadowMaps::BeginStatic(RenderQueue& queue, const glm::vec3& lightDirection, const AABB& casters)
+{
+    passStart = std::chrono::steady_clock::now();
+    staticDirection = glm::normalize(lightDirection);
+    staticValid = true;
+
+    // Tight fit around the whole static scene; every receiver lies inside it.
+    Layer& layer = staticLayer;
+    layer.view = lightView(lightDirection);
+    AABB box = TransformBox(casters, layer.view);
+    glm::vec3 margin = (box.max - box.min) * 0.01f + glm::vec3(0.1f);
+    box.min -= margin;
+    box.max += margin;
+    layer.projection = glm::ortho(box.min.x, box.max.x, box.min.y, box.max.y, -box.max.z, -box.min.z);
+    layer.texelWorld = std::max(box.max.x - box.min.x, box.max.y - box.min.y) / layer.size;
+    layer.depthRange = box.max.z - box.min.z;
+    queue.Begin(layer.view, layer.projection, layer.depthRange, static_cast<float>(layer.size));
+}
+
+void ShadowMaps::RenderStatic(RenderQueue& queue, Shader& depthShader)
+{
+    staticTimer.Begin();
+    renderLayer(staticLayer, queue, depthShader);
+    staticTimer.End();
+    stats.staticRenders++;
+    stats.staticDraws = queue.GetStats().commands;
+    stats.staticCpuMs = elapsedMs(passStart);
+}
+
+void ShadowMaps::BeginDynamic(RenderQueue& queue, const glm::vec3& lightDirection, const AABB& casters)
+{
+    passStart = std::chrono::steady_clock::now();
+
+    // A square of fixed size (the box diagonal) snapped to whole texels, so the shadow does not
+    // shimmer as the casters move and turn.
+    Layer& layer = dynamicLayer;
+    layer.view = lightView(lightDirection);
+    AABB box = TransformBox(casters, layer.view);
+    float extent = glm::length(casters.max - casters.min) * 0.5f + 0.1f;
+    layer.texelWorld = 2.0f * extent / layer.size;
+    glm::vec2 center = glm::vec2(box.Center());
+    center = glm::floor(center / layer.texelWorld) * layer.texelWorld;
+    // Depth covers the casters only; receivers behind them are clamped to the far plane in shadows.glsl.
+    float nearZ = -box.max.z - 0.1f, farZ = -box.min.z + 0.1f;
+    layer.projection = glm::ortho(center.x - extent, center.x + extent, center.y - extent, center.y + extent, nearZ, farZ);
+    layer.depthRange = farZ - nearZ;
+    queue.Begin(layer.view, layer.projection, layer.depthRange, static_cast<float>(layer.size));
+}
+
+void ShadowMaps::RenderDynamic(RenderQueue& queue, Shader& depthShader)
+{
+    dynamicTimer.Begin();
+    renderLayer(dynamicLayer, queue, depthShader);
+    dynamicTimer.End();
+    stats.dynamicDraws = queue.GetStats().commands;
+    stats.dynamicCpuMs = elapsedMs(passStart);
+}
+
+void ShadowMaps::renderLayer(Layer& layer, RenderQueue& queue, Shader& depthShader)
+{
+    GLint viewport[4], framebuffer;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, layer.FBO);
+    glViewport(0, 0, layer.size, layer.size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    // Slope-scaled offset against acne on surfaces grazing the light.
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    depthShader.use();
+    depthShader.setMat4("lightSpaceMatrix", layer.projection * layer.view);
+    queue.Prepare();
+    queue.ExecuteLayer(RenderQueue::Opaque);
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void ShadowMaps::Bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + STATIC_UNIT);
+    glBindTexture(GL_TEXTURE_2D, staticLayer.depthTexture);
+    glActiveTexture(GL_TEXTURE0 + DYNAMIC_UNIT);
+    glBindTexture(GL_TEXTURE_2D, dynamicLayer.depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowMaps::Attach(Shader& shader) const
+{
+    shader.use();
+    shader.setInt("staticShadowMap", STATIC_UNIT);
+    shader.setInt("dynamicShadowMap", DYNAMIC_UNIT);
+}
+
+void ShadowMaps::FillUniforms(LightUniforms& uniforms) const
+{
+    uniforms.staticShadowMatrix = TEXTURE_BIAS * staticLayer.projection * staticLayer.view;
+    uniforms.dynamicShadowMatrix = TEXTURE_BIAS * dynamicLayer.projection * dynamicLayer.view;
+    // Receivers are pushed 1.5 texels along their normal; the depth bias is one texel's worth of depth.
+    uniforms.shadowBias = glm::vec4(1.5f * staticLayer.texelWorld, 1.5f * dynamicLayer.texelWorld,
+        staticLayer.texelWorld / staticLayer.depthRange, dynamicLayer.texelWorld / dynamicLayer.depthRange);
+}
+
+const ShadowMaps::Stats& ShadowMaps::GetStats()
+{
+    staticTimer.Poll();
+    dynamicTimer.Poll();
+    stats.staticGpuMs = staticTimer.LastMs();
+    stats.dynamicGpuMs = dynamicTimer.LastMs();
+    return stats;
+}
@@ -0,0 +1,86 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstddef>
+#include "Bounds.h"
+#include "GpuTimer.h"
+#include "RenderQueue.h"
+#include "SceneUniforms.h"
+#include "Shader.h"
+
+// Sun shadows in two layers. The static layer covers the static scene with a large map that is
+// rendered once and kept until the light direction changes (day/night switch) or Invalidate() is
+// called. The dynamic layer is a small map fitted around the moving casters and re-rendered every
+// frame; shadows.glsl takes the darker of the two.
+//
+// A pass is: Begin*() sets up the light view on the caller's queue, the caller submits casters
+// (Model::SubmitShadowCasters), Render*() draws them into the layer.
+class ShadowMaps {
+public:
+    static const int STATIC_SIZE = 4096;
+    static const int DYNAMIC_SIZE = 1024;
+    // Units of staticShadowMap and dynamicShadowMap, after the light cluster buffers.
+    static const GLuint STATIC_UNIT = 11;
+    static const GLuint DYNAMIC_UNIT = 12;
+
+    struct Stats {
+        size_t staticRenders = 0;        // static layer renders since startup
+        size_t staticDraws = 0;          // commands of the last static render
+        size_t dynamicDraws = 0;
+        double staticCpuMs = 0.0;        // submit + execute of the last static render
+        double dynamicCpuMs = 0.0;
+        double staticGpuMs = 0.0;        // GL_TIME_ELAPSED of the last static render
+        double dynamicGpuMs = 0.0;
+    };
+
+    ShadowMaps();
+    ~ShadowMaps();
+    ShadowMaps(const ShadowMaps&) = delete;
+    ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+    // True when the static layer is stale for this light direction.
+    bool NeedsStaticUpdate(const glm::vec3& lightDirection) const;
+    // Forces the next NeedsStaticUpdate() to true, e.g. after static geometry moved.
+    void Invalidate() { staticValid = false; }
+
+    void BeginStatic(RenderQueue& queue, const glm::vec3& lightDirection, const AABB& casters);
+    void RenderStatic(RenderQueue& queue, Shader& depthShader);
+    void BeginDynamic(RenderQueue& queue, const glm::vec3& lightDirection, const AABB& casters);
+    void RenderDynamic(RenderQueue& queue, Shader& depthShader);
+
+    // Binds both maps to their units; the passes above leave the bindings alone.
+    void Bind() const;
+    // Points the program's shadow samplers at their units.
+    void Attach(Shader& shader) const;
+    void FillUniforms(LightUniforms& uniforms) const;
+
+    // Polls the GPU timers, so the times trail the passes by a frame or two.
+    const Stats& GetStats();
+
+private:
+    struct Layer {
+        int size = 0;
+        unsigned int FBO = 0;
+        unsigned int depthTexture = 0;
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        float texelWorld = 0.0f;   // world size of one texel
+        float depthRange = 1.0f;
+    };
+
+    Layer staticLayer, dynamicLayer;
+    GpuTimer staticTimer, dynamicTimer;
+    bool staticValid = false;
+    glm::vec3 staticDirection = glm::vec3(0.0f);
+    std::chrono::steady_clock::time_point passStart;
+    Stats stats;
+
+    void createLayer(Layer& layer, int size);
+    void deleteLayer(Layer& layer);
+    void renderLayer(Layer& layer, RenderQueue& queue, Shader& depthShader);
+};
+
+#endif
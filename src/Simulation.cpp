@@ -0,0 +1,313 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace {
+
+// Further behind than this (a breakpoint, a suspended laptop) the thread gives up catching up
+// instead of replaying every missed tick at once.
+const std::chrono::milliseconds MAX_LAG(250);
+
+const glm::vec3 TOP_VIEW_POSITION(-68.0f, 12.0f, -11.0f);
+const glm::vec3 FOLLOW_OFFSET(13.0f, 2.0f, 1.8f);
+const glm::vec3 HEADLIGHT_OFFSET_LEFT(1.2f, 0.3f, -5.2f);
+const glm::vec3 HEADLIGHT_OFFSET_RIGHT(2.2f, 0.3f, -5.2f);
+
+Light mixLight(const Light& a, const Light& b, float t)
+{
+    Light light = b;
+    light.position = glm::mix(a.position, b.position, t);
+    light.direction = glm::normalize(glm::mix(a.direction, b.direction, t));
+    light.color = glm::mix(a.color, b.color, t);
+    light.range = glm::mix(a.range, b.range, t);
+    return light;
+}
+
+} // namespace
+
+glm::mat4 SimulationState::ViewMatrix() const
+{
+    return glm::lookAt(viewPosition, viewPosition + viewFront, viewUp);
+}
+
+Simulation::Simulation()
+    : camera(glm::vec3(0.0f, 2.0f, 10.0f)),
+      carPosition(55.0f, -1.78f, 1.5f),
+      carRotation(-90.0f),
+      leftHeadlight(glm::vec3(0.0f), glm::vec3(0.0f, -0.2f, 1.0f), glm::vec3(0.9f, 0.85f, 0.7f), 10.5f,
+          glm::cos(glm::radians(16.0f)), glm::cos(glm::radians(22.0f)), 8.0f),
+      rightHeadlight(leftHeadlight)
+{
+    current = capture();
+    Frame& frame = frames.WriteSlot();
+    frame.previous = current;
+    frame.current = current;
+    frame.publishedAt = std::chrono::steady_clock::now();
+    frames.Publish();
+}
+
+Simulation::~Simulation()
+{
+    Stop();
+}
+
+void Simulation::Start()
+{
+    if (!thread.joinable())
+        thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::Stop()
+{
+    if (!thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    thread.join();
+    stopping = false;
+}
+
+void Simulation::Step()
+{
+    tick();
+}
+
+void Simulation::PushInput(const SimulationInput& input)
+{
+    std::lock_guard<std::mutex> lock(inputMutex);
+    glm::vec2 mouse = pendingInput.mouse + input.mouse;
+    pendingInput = input;
+    pendingInput.mouse = mouse;
+}
+
+SimulationState Simulation::Sample()
+{
+    const Frame& frame = frames.Read();
+    if (!thread.joinable() || frame.current.cut)
+        return frame.current;
+
+    // The previous tick at the moment the current one was published, the current one a tick later.
+    float t = static_cast<float>(std::chrono::duration<double>(std::chrono::steady_clock::now() - frame.publishedAt).count() * TICK_RATE);
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    const SimulationState& a = frame.previous;
+    const SimulationState& b = frame.current;
+    SimulationState state = b;
+    state.time = a.time + (b.time - a.time) * t;
+    state.carPosition = glm::mix(a.carPosition, b.carPosition, t);
+    state.carRotation = glm::mix(a.carRotation, b.carRotation, t);
+    state.viewPosition = glm::mix(a.viewPosition, b.viewPosition, t);
+    state.viewFront = glm::normalize(glm::mix(a.viewFront, b.viewFront, t));
+    state.viewUp = glm::normalize(glm::mix(a.viewUp, b.viewUp, t));
+    for (int i = 0; i < 2; i++)
+        state.headlights[i] = mixLight(a.headlights[i], b.headlights[i], t);
+    return state;
+}
+
+Simulation::Stats Simulation::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return stats;
+}
+
+void Simulation::run()
+{
+    const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / TICK_RATE));
+    auto next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopping) {
+        lock.unlock();
+        tick();
+        lock.lock();
+
+        next += interval;
+        auto now = std::chrono::steady_clock::now();
+        if (now - next > MAX_LAG) {
+            next = now;
+            std::lock_guard<std::mutex> statsLock(statsMutex);
+            stats.skips++;
+        }
+        stopSignal.wait_until(lock, next, [this] { return stopping; });
+    }
+}
+
+void Simulation::tick()
+{
+    auto start = std::chrono::steady_clock::now();
+    SimulationInput input;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input = pendingInput;
+        pendingInput.mouse = glm::vec2(0.0f);
+    }
+
+    CameraMode previousCamera = activeCamera;
+    applyInput(input);
+    carLooped = false;
+    updateCarMovement(1.0f / TICK_RATE);
+
+    Frame& frame = frames.WriteSlot();
+    frame.previous = current;
+    uint64_t tickIndex = current.tick + 1;
+    current = capture();
+    current.tick = tickIndex;
+    current.time = static_cast<double>(tickIndex) / TICK_RATE;
+    current.cut = carLooped || activeCamera != previousCamera;
+    frame.current = current;
+    frame.publishedAt = std::chrono::steady_clock::now();
+    frames.Publish();
+
+    double ms = std::chrono::duration<double, std::milli>(frame.publishedAt - start).count();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.ticks++;
+    stats.totalStepMs += ms;
+    stats.maxStepMs = std::max(stats.maxStepMs, ms);
+}
+
+void Simulation::applyInput(const SimulationInput& input)
+{
+    const float deltaTime = 1.0f / TICK_RATE;
+    if (input.forward)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (input.backward)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (input.left)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (input.right)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (input.up)
+        camera.ProcessKeyboard(UP, deltaTime);
+    if (input.down)
+        camera.ProcessKeyboard(DOWN, deltaTime);
+
+    if (input.rollLeft)
+        camera.ProcessRoll(-1.0f);
+    if (input.rollRight)
+        camera.ProcessRoll(1.0f);
+    if (input.mouse != glm::vec2(0.0f))
+        camera.ProcessMouseMovement(input.mouse.x, input.mouse.y);
+
+    if (input.cameraDefault)
+        activeCamera = DEFAULT;
+    if (input.cameraTop)
+        activeCamera = TOP;
+    if (input.cameraFollow)
+        activeCamera = FOLLOW;
+
+    if (input.headlightUp)
+        headlightDirection.y += 0.005f;
+    if (input.headlightDown)
+        headlightDirection.y -= 0.005f;
+    if (input.headlightLeft)
+        headlightDirection.x -= 0.005f;
+    if (input.headlightRight)
+        headlightDirection.x += 0.005f;
+    if (input.headlightBrighter)
+        headlightIntensity = glm::min(1.0f, headlightIntensity + 0.005f);
+    if (input.headlightDimmer)
+        headlightIntensity = glm::max(0.0f, headlightIntensity - 0.005f);
+
+    if ((input.nightPresses - nightPresses) & 1u)
+        isNight = !isNight;
+    nightPresses = input.nightPresses;
+}
+
+SimulationState Simulation::capture()
+{
+    SimulationState state;
+    state.carPosition = carPosition;
+    state.carRotation = carRotation;
+    state.activeCamera = activeCamera;
+    state.isNight = isNight;
+
+    glm::vec3 upDirection(0.0f, 1.0f, 0.0f);
+    if (activeCamera == TOP) {
+        state.viewPosition = TOP_VIEW_POSITION;
+        state.viewFront = glm::normalize(carPosition - TOP_VIEW_POSITION);
+        state.viewUp = upDirection;
+    }
+    else if (activeCamera == FOLLOW) {
+        float deltaAngle = glm::radians(carRotation - (-90.0f));
+        glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), deltaAngle, upDirection);
+        state.viewPosition = carPosition + glm::vec3(rotationMatrix * glm::vec4(FOLLOW_OFFSET, 1.0f));
+        state.viewFront = glm::normalize(carPosition - state.viewPosition);
+        state.viewUp = upDirection;
+    }
+    else {
+        state.viewPosition = camera.Position;
+        state.viewFront = camera.Front;
+        state.viewUp = camera.Up;
+    }
+
+    // The headlights ride with the car.
+    glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(carRotation), upDirection);
+    glm::vec3 direction = glm::normalize(glm::vec3(rotationMatrix * glm::vec4(headlightDirection, 0.0f)));
+    leftHeadlight.position = carPosition + glm::vec3(rotationMatrix * glm::vec4(HEADLIGHT_OFFSET_LEFT, 1.0f));
+    rightHeadlight.position = carPosition + glm::vec3(rotationMatrix * glm::vec4(HEADLIGHT_OFFSET_RIGHT, 1.0f));
+    leftHeadlight.direction = direction;
+    rightHeadlight.direction = direction;
+    leftHeadlight.intensity = headlightIntensity;
+    rightHeadlight.intensity = headlightIntensity;
+    state.headlights[0] = leftHeadlight.ToLight();
+    state.headlights[1] = rightHeadlight.ToLight();
+    return state;
+}
+
+void Simulation::updateCarMovement(float deltaTime) {
+    float normalSpeed = 6.0f;
+    float turnSpeed = 2.0f;
+    float speedChangeRate = 3.0f;
+
+    float turnStartX = -63.5f;
+    float turnEndX = -64.0f;
+    float startZ = 1.5f;
+    float endZ = 11.0f;
+
+    switch (carState) {
+    case MOVING_FORWARD:
+        if (carPosition.x > turnStartX) {
+            carPosition.x -= currentSpeed * deltaTime;
+        }
+        else {
+            carState = TURNING_RIGHT;
+            turnProgress = 0.0f;
+        }
+        break;
+
+    case TURNING_RIGHT:
+        if (turnProgress < 1.0f) {
+            currentSpeed = glm::mix(normalSpeed, turnSpeed, turnProgress);
+
+            float t = turnProgress;
+            float arcOffset = sin(t * glm::pi<float>()) * 1.0f;
+            carPosition.x = glm::mix(turnStartX, turnEndX, t);
+            carPosition.z = glm::mix(startZ, endZ, t) + arcOffset;
+            carRotation = glm::mix(-90.0f, 0.0f, t);
+
+            turnProgress += (currentSpeed / normalSpeed) * deltaTime * 0.7f;
+        }
+        else {
+            carPosition.x = turnEndX;
+            carPosition.z = endZ;
+            carState = MOVING_FORWARD_AFTER_TURN;
+            currentSpeed = turnSpeed;
+        }
+        break;
+
+    case MOVING_FORWARD_AFTER_TURN:
+        currentSpeed = glm::mix(currentSpeed, normalSpeed, deltaTime * speedChangeRate);
+        carPosition.z += currentSpeed * deltaTime;
+
+        if (carPosition.z > 48.0f) {
+            carPosition = glm::vec3(55.0f, -1.78f, 2.0f);
+            carRotation = -90.0f;
+            carState = MOVING_FORWARD;
+            currentSpeed = normalSpeed;
+            carLooped = true;
+        }
+        break;
+    }
+}
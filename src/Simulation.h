@@ -0,0 +1,121 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "Camera.h"
+#include "CarHeadlight.h"
+#include "Light.h"
+#include "TripleBuffer.h"
+
+enum CameraMode { DEFAULT, TOP, FOLLOW };
+
+// Keys and mouse movement the simulation reacts to. GLFW input may only be read on the main
+// thread, so that thread samples it every frame and hands it over with Simulation::PushInput.
+struct SimulationInput {
+    bool forward = false, backward = false, left = false, right = false, up = false, down = false; // W S A D space C
+    bool rollLeft = false, rollRight = false;                                                   // Q E
+    bool cameraDefault = false, cameraTop = false, cameraFollow = false;                        // 1 2 3
+    bool headlightUp = false, headlightDown = false, headlightLeft = false, headlightRight = false; // arrows
+    bool headlightBrighter = false, headlightDimmer = false;                                     // page up/down
+    unsigned int nightPresses = 0;  // N presses so far; a press shorter than a tick still counts
+    glm::vec2 mouse = glm::vec2(0.0f); // cursor movement since the last push (x right, y up)
+};
+
+// Everything the renderer takes from one simulation tick.
+struct SimulationState {
+    uint64_t tick = 0;
+    double time = 0.0;                  // simulated seconds at the end of the tick
+    glm::vec3 carPosition = glm::vec3(0.0f);
+    float carRotation = 0.0f;           // degrees around Y
+    CameraMode activeCamera = DEFAULT;
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+    glm::vec3 viewFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 viewUp = glm::vec3(0.0f, 1.0f, 0.0f);
+    bool isNight = false;
+    Light headlights[2] = {};
+    bool cut = false;                   // car or camera jumped this tick; do not blend into it
+
+    glm::mat4 ViewMatrix() const;
+};
+
+// Simulation (car, cameras, headlights, day/night) on a fixed tick, independent of the frame rate.
+// Start() runs it on its own thread at TICK_RATE; every tick publishes the last two states through
+// a triple buffer, and Sample() blends them by how far the render thread is into the next tick,
+// so rendering shows the simulation one tick late but smooth. Without Start(), Step() runs a tick
+// on the caller's thread and Sample() returns it as is (headless runs, reproducible frames).
+class Simulation {
+public:
+    static const int TICK_RATE = 60;
+
+    struct Stats {
+        uint64_t ticks = 0;
+        double totalStepMs = 0.0;   // CPU time spent in ticks
+        double maxStepMs = 0.0;
+        uint64_t skips = 0;         // times the thread fell too far behind and dropped ticks
+    };
+
+    Simulation();
+    ~Simulation();
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    void Start();
+    void Stop();
+    void Step();
+
+    // Replaces the held keys and adds the mouse movement to what the next tick will apply.
+    void PushInput(const SimulationInput& input);
+
+    // Render thread only.
+    SimulationState Sample();
+    Stats GetStats() const;
+
+private:
+    struct Frame {
+        SimulationState previous, current;
+        std::chrono::steady_clock::time_point publishedAt;
+    };
+
+    void run();
+    void tick();
+    void applyInput(const SimulationInput& input);
+    void updateCarMovement(float deltaTime);
+    SimulationState capture();
+
+    // Owned by whichever thread ticks.
+    Camera camera;
+    glm::vec3 carPosition;
+    float carRotation;
+    enum CarState { MOVING_FORWARD, TURNING_RIGHT, MOVING_FORWARD_AFTER_TURN };
+    CarState carState = MOVING_FORWARD;
+    float turnProgress = 0.0f;
+    float currentSpeed = 6.0f;
+    bool carLooped = false;
+    CameraMode activeCamera = DEFAULT;
+    bool isNight = false;
+    unsigned int nightPresses = 0;
+    glm::vec3 headlightDirection = glm::vec3(0.0f, -0.3f, 1.0f);
+    float headlightIntensity = 0.5f;
+    CarHeadlight leftHeadlight, rightHeadlight;
+    SimulationState current;
+
+    TripleBuffer<Frame> frames;
+
+    std::mutex inputMutex;
+    SimulationInput pendingInput;
+
+    mutable std::mutex statsMutex;
+    Stats stats;
+
+    std::thread thread;
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+};
+
+#endif
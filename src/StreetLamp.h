@@ -2,6 +2,7 @@
 #define STREETLAMP_H
 
 #include <glm/glm.hpp>
+#include "Light.h"
 
 class StreetLamp {
 public:
@@ -16,6 +17,14 @@ public:
     StreetLamp(glm::vec3 pos, glm::vec3 dir, glm::vec3 col, float intens, float cut, float outerCut, float rad)
         : position(pos), direction(glm::normalize(dir)), color(col), intensity(intens),
         cutoff(cut), outerCutoff(outerCut), radius(rad) {}
+
+    // Entry for the clustered light list.
+    Light ToLight() const
+    {
+        glm::vec3 premultiplied = color * intensity;
+        return { position, cutoff, direction, outerCutoff, premultiplied, radius, LightType::StreetLamp,
+            StreetLampRange(radius, Brightness(premultiplied)) };
+    }
 };
 
 #endif
@@ -0,0 +1,411 @@
+#include "TangentSpace.h"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENT_SSE 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TANGENT_AVX2 1
+#define TANGENT_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define TANGENT_AVX2 1
+#define TANGENT_AVX2_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+void TangentStreams::Resize(size_t vertexCount)
+{
+    for (std::vector<float>* stream : { &px, &py, &pz, &u, &v })
+        stream->resize(vertexCount);
+    for (std::vector<float>* stream : { &tx, &ty, &tz, &bx, &by, &bz })
+        stream->resize(vertexCount, 0.0f);
+}
+
+namespace {
+
+// Tangent (t[0..2]) and bitangent (t[3..5]) of one triangle, in the order of the original glm code.
+inline void triangleTangent(const TangentStreams& s, unsigned int i0, unsigned int i1, unsigned int i2, float t[6])
+{
+    float e1x = s.px[i1] - s.px[i0], e1y = s.py[i1] - s.py[i0], e1z = s.pz[i1] - s.pz[i0];
+    float e2x = s.px[i2] - s.px[i0], e2y = s.py[i2] - s.py[i0], e2z = s.pz[i2] - s.pz[i0];
+    float du1 = s.u[i1] - s.u[i0], dv1 = s.v[i1] - s.v[i0];
+    float du2 = s.u[i2] - s.u[i0], dv2 = s.v[i2] - s.v[i0];
+
+    float f = (du1 * dv2 - du2 * dv1);
+    if (std::fabs(f) > 1e-6f) f = 1.0f / f;
+    else f = 0.0f;
+
+    t[0] = f * (dv2 * e1x - dv1 * e2x);
+    t[1] = f * (dv2 * e1y - dv1 * e2y);
+    t[2] = f * (dv2 * e1z - dv1 * e2z);
+    t[3] = f * (-du2 * e1x + du1 * e2x);
+    t[4] = f * (-du2 * e1y + du1 * e2y);
+    t[5] = f * (-du2 * e1z + du1 * e2z);
+}
+
+// Scattered sums stay scalar and in triangle order: two triangles of one batch often share a vertex.
+inline void accumulate(TangentStreams& s, unsigned int i0, unsigned int i1, unsigned int i2, const float t[6])
+{
+    for (unsigned int i : { i0, i1, i2 }) {
+        s.tx[i] += t[0]; s.ty[i] += t[1]; s.tz[i] += t[2];
+    }
+    for (unsigned int i : { i0, i1, i2 }) {
+        s.bx[i] += t[3]; s.by[i] += t[4]; s.bz[i] += t[5];
+    }
+}
+
+// glm::normalize: v * (1 / sqrt(dot(v, v))), the dot summed x + y + z.
+inline void normalize(float& x, float& y, float& z)
+{
+    float inverse = 1.0f / std::sqrt(x * x + y * y + z * z);
+    x *= inverse; y *= inverse; z *= inverse;
+}
+
+void accumulateScalar(TangentStreams& s, const std::vector<unsigned int>& indices, size_t firstTriangle)
+{
+    float t[6];
+    for (size_t i = firstTriangle * 3; i + 2 < indices.size(); i += 3) {
+        triangleTangent(s, indices[i], indices[i + 1], indices[i + 2], t);
+        accumulate(s, indices[i], indices[i + 1], indices[i + 2], t);
+    }
+}
+
+void normalizeScalar(TangentStreams& s, size_t first)
+{
+    for (size_t i = first; i < s.Size(); i++) {
+        normalize(s.tx[i], s.ty[i], s.tz[i]);
+        normalize(s.bx[i], s.by[i], s.bz[i]);
+    }
+}
+
+#ifdef TANGENT_SSE
+void accumulateSSE(TangentStreams& s, const std::vector<unsigned int>& indices)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 epsilon = _mm_set1_ps(1e-6f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const size_t triangles = indices.size() / 3;
+    alignas(16) float lanes[6][4];
+
+    size_t t = 0;
+    for (; t + 4 <= triangles; t += 4) {
+        const unsigned int* idx = &indices[t * 3];
+        auto gather = [&](const std::vector<float>& stream, int corner) {
+            return _mm_set_ps(stream[idx[9 + corner]], stream[idx[6 + corner]], stream[idx[3 + corner]], stream[idx[corner]]);
+        };
+        __m128 x0 = gather(s.px, 0), y0 = gather(s.py, 0), z0 = gather(s.pz, 0);
+        __m128 u0 = gather(s.u, 0), v0 = gather(s.v, 0);
+        __m128 e1x = _mm_sub_ps(gather(s.px, 1), x0), e1y = _mm_sub_ps(gather(s.py, 1), y0), e1z = _mm_sub_ps(gather(s.pz, 1), z0);
+        __m128 e2x = _mm_sub_ps(gather(s.px, 2), x0), e2y = _mm_sub_ps(gather(s.py, 2), y0), e2z = _mm_sub_ps(gather(s.pz, 2), z0);
+        __m128 du1 = _mm_sub_ps(gather(s.u, 1), u0), dv1 = _mm_sub_ps(gather(s.v, 1), v0);
+        __m128 du2 = _mm_sub_ps(gather(s.u, 2), u0), dv2 = _mm_sub_ps(gather(s.v, 2), v0);
+
+        __m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+        __m128 usable = _mm_cmpgt_ps(_mm_and_ps(det, absMask), epsilon);
+        __m128 f = _mm_and_ps(usable, _mm_div_ps(one, det));
+        __m128 negDu2 = _mm_xor_ps(du2, signMask);
+
+        _mm_store_ps(lanes[0], _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1x), _mm_mul_ps(dv1, e2x))));
+        _mm_store_ps(lanes[1], _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1y), _mm_mul_ps(dv1, e2y))));
+        _mm_store_ps(lanes[2], _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1z), _mm_mul_ps(dv1, e2z))));
+        _mm_store_ps(lanes[3], _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(negDu2, e1x), _mm_mul_ps(du1, e2x))));
+        _mm_store_ps(lanes[4], _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(negDu2, e1y), _mm_mul_ps(du1, e2y))));
+        _mm_store_ps(lanes[5], _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(negDu2, e1z), _mm_mul_ps(du1, e2z))));
+
+        for (int lane = 0; lane < 4; lane++) {
+            const float tangent[6] = { lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane], lanes[4][lane], lanes[5][lane] };
+            accumulate(s, idx[lane * 3], idx[lane * 3 + 1], idx[lane * 3 + 2], tangent);
+        }
+    }
+    accumulateScalar(s, indices, t);
+}
+
+void normalizeSSE(TangentStreams& s)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    float* streams[2][3] = { { s.tx.data(), s.ty.data(), s.tz.data() }, { s.bx.data(), s.by.data(), s.bz.data() } };
+    size_t i = 0;
+    for (; i + 4 <= s.Size(); i += 4) {
+        for (float** xyz : streams) {
+            __m128 vx = _mm_loadu_ps(xyz[0] + i), vy = _mm_loadu_ps(xyz[1] + i), vz = _mm_loadu_ps(xyz[2] + i);
+            __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+            __m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+            _mm_storeu_ps(xyz[0] + i, _mm_mul_ps(vx, inverse));
+            _mm_storeu_ps(xyz[1] + i, _mm_mul_ps(vy, inverse));
+            _mm_storeu_ps(xyz[2] + i, _mm_mul_ps(vz, inverse));
+        }
+    }
+    normalizeScalar(s, i);
+}
+#endif
+
+#ifdef TANGENT_AVX2
+bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+TANGENT_AVX2_TARGET inline __m256 gather(const std::vector<float>& stream, __m256i index)
+{
+    return _mm256_i32gather_ps(stream.data(), index, 4);
+}
+
+TANGENT_AVX2_TARGET void accumulateAVX2(TangentStreams& s, const std::vector<unsigned int>& indices)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 epsilon = _mm256_set1_ps(1e-6f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i next = _mm256_set1_epi32(1);
+    const size_t triangles = indices.size() / 3;
+    alignas(32) float lanes[6][8];
+
+    size_t t = 0;
+    for (; t + 8 <= triangles; t += 8) {
+        const int* idx = reinterpret_cast<const int*>(&indices[t * 3]);
+        __m256i i0 = _mm256_i32gather_epi32(idx, stride, 4);
+        __m256i i1 = _mm256_i32gather_epi32(idx, _mm256_add_epi32(stride, next), 4);
+        __m256i i2 = _mm256_i32gather_epi32(idx, _mm256_add_epi32(stride, _mm256_add_epi32(next, next)), 4);
+        __m256 x0 = gather(s.px, i0), y0 = gather(s.py, i0), z0 = gather(s.pz, i0);
+        __m256 u0 = gather(s.u, i0), v0 = gather(s.v, i0);
+        __m256 e1x = _mm256_sub_ps(gather(s.px, i1), x0), e1y = _mm256_sub_ps(gather(s.py, i1), y0), e1z = _mm256_sub_ps(gather(s.pz, i1), z0);
+        __m256 e2x = _mm256_sub_ps(gather(s.px, i2), x0), e2y = _mm256_sub_ps(gather(s.py, i2), y0), e2z = _mm256_sub_ps(gather(s.pz, i2), z0);
+        __m256 du1 = _mm256_sub_ps(gather(s.u, i1), u0), dv1 = _mm256_sub_ps(gather(s.v, i1), v0);
+        __m256 du2 = _mm256_sub_ps(gather(s.u, i2), u0), dv2 = _mm256_sub_ps(gather(s.v, i2), v0);
+
+        __m256 det = _mm256_sub_ps(_mm256_mul_ps(du1, dv2), _mm256_mul_ps(du2, dv1));
+        __m256 usable = _mm256_cmp_ps(_mm256_and_ps(det, absMask), epsilon, _CMP_GT_OQ);
+        __m256 f = _mm256_and_ps(usable, _mm256_div_ps(one, det));
+        __m256 negDu2 = _mm256_xor_ps(du2, signMask);
+
+        _mm256_store_ps(lanes[0], _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(dv2, e1x), _mm256_mul_ps(dv1, e2x))));
+        _mm256_store_ps(lanes[1], _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(dv2, e1y), _mm256_mul_ps(dv1, e2y))));
+        _mm256_store_ps(lanes[2], _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(dv2, e1z), _mm256_mul_ps(dv1, e2z))));
+        _mm256_store_ps(lanes[3], _mm256_mul_ps(f, _mm256_add_ps(_mm256_mul_ps(negDu2, e1x), _mm256_mul_ps(du1, e2x))));
+        _mm256_store_ps(lanes[4], _mm256_mul_ps(f, _mm256_add_ps(_mm256_mul_ps(negDu2, e1y), _mm256_mul_ps(du1, e2y))));
+        _mm256_store_ps(lanes[5], _mm256_mul_ps(f, _mm256_add_ps(_mm256_mul_ps(negDu2, e1z), _mm256_mul_ps(du1, e2z))));
+
+        const unsigned int* corners = &indices[t * 3];
+        for (int lane = 0; lane < 8; lane++) {
+            const float tangent[6] = { lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane], lanes[4][lane], lanes[5][lane] };
+            accumulate(s, corners[lane * 3], corners[lane * 3 + 1], corners[lane * 3 + 2], tangent);
+        }
+    }
+    accumulateScalar(s, indices, t);
+}
+
+TANGENT_AVX2_TARGET void normalizeAVX2(TangentStreams& s)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    float* streams[2][3] = { { s.tx.data(), s.ty.data(), s.tz.data() }, { s.bx.data(), s.by.data(), s.bz.data() } };
+    size_t i = 0;
+    for (; i + 8 <= s.Size(); i += 8) {
+        for (float** xyz : streams) {
+            __m256 vx = _mm256_loadu_ps(xyz[0] + i), vy = _mm256_loadu_ps(xyz[1] + i), vz = _mm256_loadu_ps(xyz[2] + i);
+            __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+            __m256 inverse = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSq));
+            _mm256_storeu_ps(xyz[0] + i, _mm256_mul_ps(vx, inverse));
+            _mm256_storeu_ps(xyz[1] + i, _mm256_mul_ps(vy, inverse));
+            _mm256_storeu_ps(xyz[2] + i, _mm256_mul_ps(vz, inverse));
+        }
+    }
+    normalizeScalar(s, i);
+}
+#endif
+
+// The loop GenerateTangents replaced, on glm vectors, as the reference for the benchmark.
+void referenceTangents(const TangentStreams& s, const std::vector<unsigned int>& indices,
+                       std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents)
+{
+    tangents.resize(s.Size());
+    bitangents.resize(s.Size());
+    for (size_t i = 0; i < s.Size(); i++) {
+        tangents[i] = glm::vec3(s.tx[i], s.ty[i], s.tz[i]);
+        bitangents[i] = glm::vec3(s.bx[i], s.by[i], s.bz[i]);
+    }
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        unsigned int i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+        glm::vec3 edge1 = glm::vec3(s.px[i1], s.py[i1], s.pz[i1]) - glm::vec3(s.px[i0], s.py[i0], s.pz[i0]);
+        glm::vec3 edge2 = glm::vec3(s.px[i2], s.py[i2], s.pz[i2]) - glm::vec3(s.px[i0], s.py[i0], s.pz[i0]);
+        glm::vec2 deltaUV1 = glm::vec2(s.u[i1], s.v[i1]) - glm::vec2(s.u[i0], s.v[i0]);
+        glm::vec2 deltaUV2 = glm::vec2(s.u[i2], s.v[i2]) - glm::vec2(s.u[i0], s.v[i0]);
+
+        float f = (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+        if (fabs(f) > 1e-6f) f = 1.0f / f;
+        else f = 0.0f;
+
+        glm::vec3 tangent, bitangent;
+        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+
+        bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+        bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+        bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+
+        tangents[i0] += tangent;
+        tangents[i1] += tangent;
+        tangents[i2] += tangent;
+
+        bitangents[i0] += bitangent;
+        bitangents[i1] += bitangent;
+        bitangents[i2] += bitangent;
+    }
+    for (size_t i = 0; i < s.Size(); i++) {
+        tangents[i] = glm::normalize(tangents[i]);
+        bitangents[i] = glm::normalize(bitangents[i]);
+    }
+}
+
+// Index of the first vertex whose tangent or bitangent bits differ, or -1.
+long firstMismatch(const TangentStreams& a, const TangentStreams& b)
+{
+    const std::vector<float> TangentStreams::* outputs[] = {
+        &TangentStreams::tx, &TangentStreams::ty, &TangentStreams::tz,
+        &TangentStreams::bx, &TangentStreams::by, &TangentStreams::bz
+    };
+    for (size_t i = 0; i < a.Size(); i++) {
+        for (auto output : outputs) {
+            if (std::memcmp(&(a.*output)[i], &(b.*output)[i], sizeof(float)) != 0)
+                return static_cast<long>(i);
+        }
+    }
+    return -1;
+}
+
+}
+
+bool TangentKernelSupported(TangentKernel kernel)
+{
+    switch (kernel) {
+    case TangentKernel::Scalar:
+        return true;
+    case TangentKernel::SSE:
+#ifdef TANGENT_SSE
+        return true;
+#else
+        return false;
+#endif
+    case TangentKernel::AVX2: {
+#ifdef TANGENT_AVX2
+        static const bool avx2 = cpuHasAvx2();
+        return avx2;
+#else
+        return false;
+#endif
+    }
+    }
+    return false;
+}
+
+TangentKernel BestTangentKernel()
+{
+    if (TangentKernelSupported(TangentKernel::AVX2))
+        return TangentKernel::AVX2;
+    if (TangentKernelSupported(TangentKernel::SSE))
+        return TangentKernel::SSE;
+    return TangentKernel::Scalar;
+}
+
+const char* TangentKernelName(TangentKernel kernel)
+{
+    switch (kernel) {
+    case TangentKernel::SSE: return "SSE";
+    case TangentKernel::AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+void GenerateTangents(TangentStreams& streams, const std::vector<unsigned int>& indices, TangentKernel kernel)
+{
+    if (!TangentKernelSupported(kernel))
+        kernel = TangentKernel::Scalar;
+#ifdef TANGENT_AVX2
+    if (kernel == TangentKernel::AVX2) {
+        accumulateAVX2(streams, indices);
+        normalizeAVX2(streams);
+        return;
+    }
+#endif
+#ifdef TANGENT_SSE
+    if (kernel == TangentKernel::SSE) {
+        accumulateSSE(streams, indices);
+        normalizeSSE(streams);
+        return;
+    }
+#endif
+    accumulateScalar(streams, indices, 0);
+    normalizeScalar(streams, 0);
+}
+
+bool BenchmarkTangentKernels(const TangentStreams& input, const std::vector<unsigned int>& indices, int runs)
+{
+    double inputMB = (input.Size() * 5 * sizeof(float) + indices.size() * sizeof(unsigned int)) / (1024.0 * 1024.0);
+    std::cout << "Tangent benchmark: " << input.Size() << " vertices, " << indices.size() / 3 << " triangles, "
+        << inputMB << " MB of positions, UVs and indices, " << runs << " runs per kernel" << std::endl;
+
+    TangentStreams scalar = input;
+    GenerateTangents(scalar, indices, TangentKernel::Scalar);
+
+    bool matches = true;
+    std::vector<glm::vec3> tangents, bitangents;
+    referenceTangents(input, indices, tangents, bitangents);
+    for (size_t i = 0; i < input.Size() && matches; i++) {
+        const float produced[6] = { scalar.tx[i], scalar.ty[i], scalar.tz[i], scalar.bx[i], scalar.by[i], scalar.bz[i] };
+        const float expected[6] = { tangents[i].x, tangents[i].y, tangents[i].z, bitangents[i].x, bitangents[i].y, bitangents[i].z };
+        if (std::memcmp(produced, expected, sizeof(produced)) != 0) {
+            std::cout << "ERROR::TANGENTS::scalar kernel differs from the glm reference at vertex " << i << std::endl;
+            matches = false;
+        }
+    }
+
+    double scalarMs = 0.0;
+    for (TangentKernel kernel : { TangentKernel::Scalar, TangentKernel::SSE, TangentKernel::AVX2 }) {
+        if (!TangentKernelSupported(kernel)) {
+            std::cout << "Tangents, " << TangentKernelName(kernel) << ": not supported here" << std::endl;
+            continue;
+        }
+        double totalMs = 0.0;
+        TangentStreams streams;
+        for (int run = 0; run < runs; run++) {
+            streams = input;
+            auto start = std::chrono::steady_clock::now();
+            GenerateTangents(streams, indices, kernel);
+            totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        double averageMs = totalMs / runs;
+        if (kernel == TangentKernel::Scalar)
+            scalarMs = averageMs;
+
+        long mismatch = firstMismatch(streams, scalar);
+        if (mismatch >= 0) {
+            std::cout << "ERROR::TANGENTS::" << TangentKernelName(kernel) << " kernel differs from the scalar one at vertex " << mismatch << std::endl;
+            matches = false;
+        }
+        std::cout << "Tangents, " << TangentKernelName(kernel) << ": " << averageMs << " ms, "
+            << input.Size() / (averageMs * 1000.0) << " M vertices/s, " << (averageMs > 0.0 ? scalarMs / averageMs : 0.0)
+            << "x scalar, " << (mismatch < 0 ? "bit-identical" : "MISMATCH") << std::endl;
+    }
+    return matches;
+}
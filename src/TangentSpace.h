@@ -0,0 +1,38 @@
+#ifndef TANGENT_SPACE_H
+#define TANGENT_SPACE_H
+
+#include <cstddef>
+#include <vector>
+
+// Vertex streams of one indexed triangle list, structure-of-arrays. The tangent and bitangent
+// streams are accumulators: GenerateTangents adds to whatever they hold (normally zero).
+struct TangentStreams {
+    std::vector<float> px, py, pz;
+    std::vector<float> u, v;
+    std::vector<float> tx, ty, tz;
+    std::vector<float> bx, by, bz;
+
+    // Grows or shrinks every stream; new tangents and bitangents are zero.
+    void Resize(size_t vertexCount);
+    size_t Size() const { return px.size(); }
+};
+
+enum class TangentKernel { Scalar, SSE, AVX2 };
+
+// Tangent and bitangent of every triangle from its position and UV deltas, summed into its three
+// vertices, then normalized per vertex. A triangle whose UV determinant is within 1e-6 of zero
+// gets f = 0 and adds nothing. The SIMD kernels set up 4 (SSE) or 8 (AVX2) triangles at a time
+// but still sum in triangle order with the scalar kernel's operations, so every kernel gives the
+// same bits. An unsupported kernel falls back to the scalar one.
+void GenerateTangents(TangentStreams& streams, const std::vector<unsigned int>& indices, TangentKernel kernel);
+bool TangentKernelSupported(TangentKernel kernel);
+// The fastest kernel this CPU runs.
+TangentKernel BestTangentKernel();
+const char* TangentKernelName(TangentKernel kernel);
+
+// Times every supported kernel over runs passes on a copy of input and checks its output bit for
+// bit against the scalar kernel, and the scalar kernel against the glm per-vertex loop it replaced.
+// Returns false on any mismatch.
+bool BenchmarkTangentKernels(const TangentStreams& input, const std::vector<unsigned int>& indices, int runs);
+
+#endif
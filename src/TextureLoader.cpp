@@ -0,0 +1,319 @@
+#include "TextureLoader.h"
+#include <cstring>
+#include <iterator>
+#include <iostream>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+
+bool hasExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+GLenum pixelFormat(int components)
+{
+    if (components == 1)
+        return GL_RED;
+    if (components == 2)
+        return GL_RG;
+    if (components == 4)
+        return GL_RGBA;
+    return GL_RGB;
+}
+
+}
+
+TextureLoader& TextureLoader::Get()
+{
+    // One core stays with the GL thread, which keeps walking the scene while the pool decodes.
+    unsigned int cores = std::thread::hardware_concurrency();
+    static TextureLoader loader(cores > 1 ? cores - 1 : 1);
+    return loader;
+}
+
+TextureLoader::TextureLoader(unsigned int threadCount)
+{
+    // stb's flip flag is global, set it once before any worker reads it.
+    stbi_set_flip_vertically_on_load(false);
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&TextureLoader::workerLoop, this);
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    for (DecodedImage& image : decoded)
+        stbi_image_free(image.data);
+    for (auto& image : unclaimed)
+        stbi_image_free(image.second.data);
+}
+
+void TextureLoader::Prefetch(const std::string& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (prefetched.count(filename))
+            return;
+        startBatch();
+        prefetched.emplace(filename, 0);
+        jobs.push_back({ 0, filename });
+    }
+    jobReady.notify_one();
+}
+
+unsigned int TextureLoader::Request(const std::string& filename)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        startBatch();
+        pending++;
+        batchCount++;
+
+        // A prefetched file is claimed once: decoded already, or named for the worker to pass on.
+        auto it = prefetched.find(filename);
+        if (it != prefetched.end() && it->second == 0) {
+            auto image = unclaimed.find(filename);
+            if (image == unclaimed.end()) {
+                it->second = textureID;
+                return textureID;
+            }
+            image->second.id = textureID;
+            decoded.push_back(std::move(image->second));
+            unclaimed.erase(image);
+            prefetched.erase(it);
+            ready = true;
+        }
+        else {
+            jobs.push_back({ textureID, filename });
+        }
+    }
+    if (ready)
+        imageReady.notify_one();
+    else
+        jobReady.notify_one();
+    return textureID;
+}
+
+size_t TextureLoader::UploadReady(double budgetMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::deque<DecodedImage> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(decoded);
+    }
+    if (ready.empty()) return 0;
+
+    // At least one image per call; what the budget leaves goes back to the front of the queue.
+    size_t uploaded = 0, fromPacks = 0;
+    double decodeMs = 0.0;
+    while (!ready.empty()) {
+        upload(ready.front());
+        decodeMs += ready.front().decodeMs;
+        fromPacks += ready.front().packEntry ? 1 : 0;
+        ready.pop_front();
+        uploaded++;
+        if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budgetMs)
+            break;
+    }
+
+    bool batchDone;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        decoded.insert(decoded.begin(), std::make_move_iterator(ready.begin()), std::make_move_iterator(ready.end()));
+        pending -= uploaded;
+        batchFromPacks += fromPacks;
+        batchDecodeMs += decodeMs;
+        batchDone = pending == 0;
+    }
+    if (batchDone) reportBatch();
+    return uploaded;
+}
+
+void TextureLoader::Finish()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending == 0) return;
+            imageReady.wait(lock, [this] { return !decoded.empty(); });
+        }
+        UploadReady();
+    }
+}
+
+size_t TextureLoader::Pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending;
+}
+
+void TextureLoader::workerLoop()
+{
+    for (;;) {
+        DecodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        DecodedImage image;
+        image.id = job.id;
+        image.filename = std::move(job.filename);
+        image.data = nullptr;
+        image.packEntry = findInPack(image.filename);
+        if (!image.packEntry)
+            image.data = stbi_load(image.filename.c_str(), &image.width, &image.height, &image.components, 0);
+        image.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (image.id == 0) {
+                auto it = prefetched.find(image.filename);
+                if (it->second == 0) {
+                    std::string filename = image.filename;
+                    unclaimed.emplace(std::move(filename), std::move(image));
+                    continue;
+                }
+                image.id = it->second;
+                prefetched.erase(it);
+            }
+            decoded.push_back(std::move(image));
+        }
+        imageReady.notify_one();
+    }
+}
+
+void TextureLoader::upload(const DecodedImage& image)
+{
+    if (image.packEntry) {
+        uploadFromPack(image.id, *image.packEntry);
+        return;
+    }
+    if (!image.data) {
+        std::cout << "Texture failed to load at path: " << image.filename << std::endl;
+        return;
+    }
+
+    GLenum format = pixelFormat(image.components);
+
+    glBindTexture(GL_TEXTURE_2D, image.id);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    stbi_image_free(image.data);
+}
+
+const TexturePackEntry* TextureLoader::findInPack(const std::string& filename)
+{
+    size_t slash = filename.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash);
+    std::string name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+
+    const TexturePack* pack;
+    {
+        std::lock_guard<std::mutex> lock(packMutex);
+        auto it = packs.find(directory);
+        if (it == packs.end()) {
+            std::unique_ptr<TexturePack> opened(new TexturePack());
+            if (opened->Open(directory))
+                std::cout << "Texture pack " << TexturePack::PackPathFor(directory) << ": " << opened->GetEntries().size() << " textures" << std::endl;
+            else
+                opened.reset();
+            it = packs.emplace(directory, std::move(opened)).first;
+        }
+        pack = it->second.get();
+    }
+    if (!pack) return nullptr;
+
+    // Hashes the source image, outside the lock so the other workers keep going.
+    const TexturePackEntry* entry = pack->Find(name);
+    return entry && !entry->levels.empty() ? entry : nullptr;
+}
+
+void TextureLoader::uploadFromPack(unsigned int textureID, const TexturePackEntry& entry)
+{
+    if (s3tcSupported < 0)
+        s3tcSupported = hasExtension("GL_EXT_texture_compression_s3tc") ? 1 : 0;
+    GLenum compressedFormat = 0;
+    if (entry.blockFormat == BLOCK_BC4)
+        compressedFormat = GL_COMPRESSED_RED_RGTC1;
+    else if (entry.blockFormat == BLOCK_BC1 && s3tcSupported)
+        compressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else if (entry.blockFormat == BLOCK_BC3 && s3tcSupported)
+        compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    GLenum format = pixelFormat(entry.components);
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < entry.levels.size(); level++) {
+        const TextureLevel& data = entry.levels[level];
+        if (compressedFormat && data.blocks)
+            glCompressedTexImage2D(GL_TEXTURE_2D, GLint(level), compressedFormat, data.width, data.height, 0,
+                GLsizei(data.blockBytes), data.blocks);
+        else
+            glTexImage2D(GL_TEXTURE_2D, GLint(level), format, data.width, data.height, 0, format, GL_UNSIGNED_BYTE, data.pixels);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(entry.levels.size() - 1));
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void TextureLoader::startBatch()
+{
+    // A batch runs from the first prefetch or request until nothing is left to upload.
+    if (pending > 0 || !prefetched.empty())
+        return;
+    batchStart = std::chrono::steady_clock::now();
+    batchCount = 0;
+    batchFromPacks = 0;
+    batchDecodeMs = 0.0;
+}
+
+void TextureLoader::reportBatch()
+{
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+    std::cout << "Textures: " << batchCount << " loaded (" << batchFromPacks << " from packs) on " << workers.size() << " threads, "
+        << batchDecodeMs << " ms decode work in " << wallMs << " ms wall";
+    if (wallMs > 0.0)
+        std::cout << " (" << batchDecodeMs / wallMs << "x parallelism)";
+    std::cout << std::endl;
+}
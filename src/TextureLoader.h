@@ -0,0 +1,94 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TexturePack.h"
+
+// Decodes image files on a pool of worker threads. The GL thread gets a texture name right away
+// from Request() and uploads the pixels later in UploadReady(), so decoding overlaps with
+// whatever the GL thread does in between (rendering the first frames). Prefetch() starts a decode
+// before there is a texture name for it, from any thread (model imports, as they read materials).
+// Images that have an up-to-date entry in their directory's TexturePack skip decoding: the worker
+// only checks the entry against the source file, and its levels are uploaded straight from the
+// mapped pack through the same budgeted queue.
+class TextureLoader {
+public:
+    static TextureLoader& Get();
+
+    explicit TextureLoader(unsigned int threadCount);
+    ~TextureLoader();
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // Any thread, no GL. Queues filename for decoding; a later Request() for it takes the result.
+    void Prefetch(const std::string& filename);
+    // GL thread only. Returns a texture name that stays empty until its image is uploaded.
+    unsigned int Request(const std::string& filename);
+    // GL thread only. Uploads images decoded so far, at least one and until budgetMs is spent,
+    // and returns how many were uploaded.
+    size_t UploadReady(double budgetMs = std::numeric_limits<double>::infinity());
+    // GL thread only. Blocks until every requested texture is uploaded.
+    void Finish();
+    size_t Pending() const;
+    unsigned int ThreadCount() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    struct DecodeJob {
+        unsigned int id;
+        std::string filename;
+    };
+
+    struct DecodedImage {
+        unsigned int id;
+        std::string filename;
+        int width, height, components;
+        unsigned char* data;
+        const TexturePackEntry* packEntry; // levels to upload instead of data, nullptr if decoded
+        double decodeMs;
+    };
+
+    void workerLoop();
+    void upload(const DecodedImage& image);
+    // Worker side: the up-to-date pack entry for filename, or nullptr.
+    const TexturePackEntry* findInPack(const std::string& filename);
+    void uploadFromPack(unsigned int textureID, const TexturePackEntry& entry);
+    // Under mutex.
+    void startBatch();
+    void reportBatch();
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable imageReady;
+    std::deque<DecodeJob> jobs;
+    std::deque<DecodedImage> decoded;
+    // Prefetched files by texture name, 0 until their Request(), and the ones decoded before it.
+    std::map<std::string, unsigned int> prefetched;
+    std::map<std::string, DecodedImage> unclaimed;
+    size_t pending = 0;
+    bool stopping = false;
+
+    // Opened by the workers on first use and kept until the loader goes away.
+    std::mutex packMutex;
+    std::map<std::string, std::unique_ptr<TexturePack>> packs;
+
+    // GL thread only.
+    int s3tcSupported = -1;
+
+    std::chrono::steady_clock::time_point batchStart;
+    size_t batchCount = 0;
+    size_t batchFromPacks = 0;
+    double batchDecodeMs = 0.0;
+};
+
+#endif
@@ -0,0 +1,472 @@
+#include "TexturePack.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char MAGIC[4] = { 'T', 'X', 'P', 'K' };
+const uint64_t DATA_ALIGNMENT = 16;
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t levelCount;
+    uint32_t stringsSize;
+    uint32_t reserved;
+};
+
+struct EntryRecord {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t components;
+    uint32_t blockFormat;
+    uint32_t firstLevel;
+    uint32_t levelCount;
+};
+
+struct LevelRecord {
+    uint32_t width;
+    uint32_t height;
+    uint64_t pixelOffset;
+    uint64_t pixelBytes;
+    uint64_t blockOffset;
+    uint64_t blockBytes;
+};
+
+uint64_t alignUp(uint64_t value)
+{
+    return (value + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+}
+
+uint16_t packRGB565(const int c[3])
+{
+    return static_cast<uint16_t>(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+void unpackRGB565(uint16_t v, int c[3])
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+// Range fit: endpoints from the inset bounding box of the block, nearest-palette indices.
+void encodeBC1Block(const unsigned char texels[16][4], unsigned char* out)
+{
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], int(texels[i][c]));
+            hi[c] = std::max(hi[c], int(texels[i][c]));
+        }
+    for (int c = 0; c < 3; c++) {
+        int inset = (hi[c] - lo[c]) / 16;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+
+    uint16_t c0 = packRGB565(hi), c1 = packRGB565(lo);
+    if (c0 < c1) std::swap(c0, c1);
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = int(texels[i][c]) - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= uint32_t(best) << (2 * i);
+        }
+    }
+
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+void decodeBC1Block(const unsigned char* in, unsigned char texels[16][4])
+{
+    uint16_t c0 = uint16_t(in[0] | in[1] << 8), c1 = uint16_t(in[2] | in[3] << 8);
+    int palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        if (c0 > c1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    uint32_t indices = uint32_t(in[4]) | uint32_t(in[5]) << 8 | uint32_t(in[6]) << 16 | uint32_t(in[7]) << 24;
+    for (int i = 0; i < 16; i++) {
+        int p = (indices >> (2 * i)) & 3;
+        for (int c = 0; c < 3; c++)
+            texels[i][c] = static_cast<unsigned char>(palette[p][c]);
+    }
+}
+
+// Single channel with 8 interpolated values; `channel` selects which texel byte is encoded.
+void encodeBC4Block(const unsigned char texels[16][4], int channel, unsigned char* out)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        lo = std::min(lo, int(texels[i][channel]));
+        hi = std::max(hi, int(texels[i][channel]));
+    }
+    out[0] = static_cast<unsigned char>(hi);
+    out[1] = static_cast<unsigned char>(lo);
+    uint64_t indices = 0;
+    if (hi != lo) {
+        for (int i = 0; i < 16; i++) {
+            int step = ((int(texels[i][channel]) - lo) * 7 + (hi - lo) / 2) / (hi - lo);
+            int code = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= uint64_t(code) << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+void decodeBC4Block(const unsigned char* in, int channel, unsigned char texels[16][4])
+{
+    int a0 = in[0], a1 = in[1];
+    int palette[8] = { a0, a1 };
+    for (int i = 2; i < 8; i++) {
+        if (a0 > a1)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        else
+            palette[i] = i < 6 ? ((6 - i) * a0 + (i - 1) * a1) / 5 : (i == 6 ? 0 : 255);
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= uint64_t(in[2 + i]) << (8 * i);
+    for (int i = 0; i < 16; i++)
+        texels[i][channel] = static_cast<unsigned char>(palette[(indices >> (3 * i)) & 7]);
+}
+
+} // namespace
+
+std::string TexturePack::PackPathFor(const std::string& directory)
+{
+    return directory + "/textures.texpack";
+}
+
+bool TexturePack::Open(const std::string& directory)
+{
+    Close();
+    if (!file.Open(PackPathFor(directory))) return false;
+    this->directory = directory;
+
+    const unsigned char* base = file.Data();
+    const size_t fileSize = file.Size();
+    PackHeader header;
+    if (fileSize < sizeof(header)) { Close(); return false; }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+        Close();
+        return false;
+    }
+
+    uint64_t entriesOffset = sizeof(PackHeader);
+    uint64_t levelsOffset = entriesOffset + uint64_t(header.entryCount) * sizeof(EntryRecord);
+    uint64_t stringsOffset = levelsOffset + uint64_t(header.levelCount) * sizeof(LevelRecord);
+    if (stringsOffset + header.stringsSize > fileSize) { Close(); return false; }
+    const char* strings = reinterpret_cast<const char*>(base + stringsOffset);
+
+    entries.reserve(header.entryCount);
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        EntryRecord record;
+        std::memcpy(&record, base + entriesOffset + i * sizeof(EntryRecord), sizeof(record));
+        if (uint64_t(record.nameOffset) + record.nameLength > header.stringsSize ||
+            uint64_t(record.firstLevel) + record.levelCount > header.levelCount)
+        {
+            Close();
+            return false;
+        }
+
+        TexturePackEntry entry;
+        entry.name.assign(strings + record.nameOffset, record.nameLength);
+        entry.sourceHash = record.sourceHash;
+        entry.sourceSize = record.sourceSize;
+        entry.width = record.width;
+        entry.height = record.height;
+        entry.components = record.components;
+        entry.blockFormat = static_cast<BlockFormat>(record.blockFormat);
+        for (uint32_t l = 0; l < record.levelCount; l++) {
+            LevelRecord level;
+            std::memcpy(&level, base + levelsOffset + (record.firstLevel + l) * sizeof(LevelRecord), sizeof(level));
+            if (level.pixelOffset + level.pixelBytes > fileSize || level.blockOffset + level.blockBytes > fileSize) {
+                Close();
+                return false;
+            }
+            TextureLevel view;
+            view.width = level.width;
+            view.height = level.height;
+            view.pixels = base + level.pixelOffset;
+            view.pixelBytes = static_cast<size_t>(level.pixelBytes);
+            view.blocks = level.blockBytes ? base + level.blockOffset : nullptr;
+            view.blockBytes = static_cast<size_t>(level.blockBytes);
+            entry.levels.push_back(view);
+        }
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+const TexturePackEntry* TexturePack::Find(const std::string& fileName) const
+{
+    for (const TexturePackEntry& entry : entries) {
+        if (entry.name != fileName) continue;
+        uint64_t hash, size;
+        if (!FileDigest(directory + "/" + fileName, hash, size) ||
+            hash != entry.sourceHash || size != entry.sourceSize) {
+            std::cout << "Texture pack " << PackPathFor(directory) << ": " << fileName
+                << " changed since the pack was built, decoding the source image" << std::endl;
+            return nullptr;
+        }
+        return &entry;
+    }
+    return nullptr;
+}
+
+void TexturePack::Close()
+{
+    entries.clear();
+    file.Close();
+}
+
+bool TexturePack::Write(const std::string& directory, const std::vector<TexturePackSource>& sources)
+{
+    PackHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.entryCount = static_cast<uint32_t>(sources.size());
+
+    std::vector<EntryRecord> entryRecords;
+    std::string strings;
+    for (const TexturePackSource& source : sources) {
+        EntryRecord record = {};
+        record.nameOffset = static_cast<uint32_t>(strings.size());
+        record.nameLength = static_cast<uint32_t>(source.name.size());
+        strings += source.name;
+        record.sourceHash = source.sourceHash;
+        record.sourceSize = source.sourceSize;
+        record.width = source.widths.empty() ? 0 : source.widths[0];
+        record.height = source.heights.empty() ? 0 : source.heights[0];
+        record.components = source.components;
+        record.blockFormat = source.blockFormat;
+        record.firstLevel = header.levelCount;
+        record.levelCount = static_cast<uint32_t>(source.pixels.size());
+        header.levelCount += record.levelCount;
+        entryRecords.push_back(record);
+    }
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+
+    uint64_t cursor = sizeof(PackHeader) + entryRecords.size() * sizeof(EntryRecord) +
+        uint64_t(header.levelCount) * sizeof(LevelRecord) + strings.size();
+    std::vector<LevelRecord> levelRecords;
+    for (const TexturePackSource& source : sources) {
+        for (size_t l = 0; l < source.pixels.size(); l++) {
+            LevelRecord level = {};
+            level.width = source.widths[l];
+            level.height = source.heights[l];
+            level.pixelOffset = alignUp(cursor);
+            level.pixelBytes = source.pixels[l].size();
+            cursor = level.pixelOffset + level.pixelBytes;
+            if (l < source.blocks.size() && !source.blocks[l].empty()) {
+                level.blockOffset = alignUp(cursor);
+                level.blockBytes = source.blocks[l].size();
+                cursor = level.blockOffset + level.blockBytes;
+            }
+            levelRecords.push_back(level);
+        }
+    }
+
+    const std::string packPath = PackPathFor(directory);
+    const std::string tempPath = packPath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entryRecords.data()), entryRecords.size() * sizeof(EntryRecord));
+        out.write(reinterpret_cast<const char*>(levelRecords.data()), levelRecords.size() * sizeof(LevelRecord));
+        out.write(strings.data(), strings.size());
+
+        const char padding[DATA_ALIGNMENT] = {};
+        uint64_t written = sizeof(PackHeader) + entryRecords.size() * sizeof(EntryRecord) +
+            levelRecords.size() * sizeof(LevelRecord) + strings.size();
+        size_t levelIndex = 0;
+        for (const TexturePackSource& source : sources) {
+            for (size_t l = 0; l < source.pixels.size(); l++) {
+                const LevelRecord& level = levelRecords[levelIndex++];
+                out.write(padding, level.pixelOffset - written);
+                out.write(reinterpret_cast<const char*>(source.pixels[l].data()), level.pixelBytes);
+                written = level.pixelOffset + level.pixelBytes;
+                if (level.blockBytes) {
+                    out.write(padding, level.blockOffset - written);
+                    out.write(reinterpret_cast<const char*>(source.blocks[l].data()), level.blockBytes);
+                    written = level.blockOffset + level.blockBytes;
+                }
+            }
+        }
+        if (!out) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, packPath, ec);
+    if (ec) {
+        std::remove(tempPath.c_str());
+        std::cout << "Warning: could not write texture pack " << packPath << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void BuildMipChain(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t components,
+    std::vector<uint32_t>& widths, std::vector<uint32_t>& heights, std::vector<std::vector<unsigned char>>& levels)
+{
+    widths.assign(1, width);
+    heights.assign(1, height);
+    levels.assign(1, std::vector<unsigned char>(pixels, pixels + size_t(width) * height * components));
+
+    while (width > 1 || height > 1) {
+        uint32_t nextWidth = std::max(1u, width / 2);
+        uint32_t nextHeight = std::max(1u, height / 2);
+        const std::vector<unsigned char>& src = levels.back();
+        std::vector<unsigned char> dst(size_t(nextWidth) * nextHeight * components);
+        for (uint32_t y = 0; y < nextHeight; y++) {
+            uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            for (uint32_t x = 0; x < nextWidth; x++) {
+                uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                for (uint32_t c = 0; c < components; c++) {
+                    int sum = src[(size_t(y0) * width + x0) * components + c] + src[(size_t(y0) * width + x1) * components + c] +
+                        src[(size_t(y1) * width + x0) * components + c] + src[(size_t(y1) * width + x1) * components + c];
+                    dst[(size_t(y) * nextWidth + x) * components + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        width = nextWidth;
+        height = nextHeight;
+        widths.push_back(width);
+        heights.push_back(height);
+        levels.push_back(std::move(dst));
+    }
+}
+
+BlockFormat BlockFormatFor(uint32_t components)
+{
+    switch (components) {
+    case 1: return BLOCK_BC4;
+    case 3: return BLOCK_BC1;
+    case 4: return BLOCK_BC3;
+    default: return BLOCK_NONE;
+    }
+}
+
+size_t BlockBytes(BlockFormat format, uint32_t width, uint32_t height)
+{
+    size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+    switch (format) {
+    case BLOCK_BC1:
+    case BLOCK_BC4: return blocks * 8;
+    case BLOCK_BC3: return blocks * 16;
+    default: return 0;
+    }
+}
+
+std::vector<unsigned char> CompressBlocks(BlockFormat format, const unsigned char* pixels,
+    uint32_t width, uint32_t height, uint32_t components)
+{
+    std::vector<unsigned char> out(BlockBytes(format, width, height));
+    unsigned char* dst = out.data();
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            // Edge blocks repeat the last row/column.
+            unsigned char texels[16][4] = {};
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = std::min(bx + i % 4, width - 1), y = std::min(by + i / 4, height - 1);
+                const unsigned char* texel = pixels + (size_t(y) * width + x) * components;
+                for (uint32_t c = 0; c < components && c < 4; c++)
+                    texels[i][c] = texel[c];
+            }
+            if (format == BLOCK_BC1) {
+                encodeBC1Block(texels, dst);
+                dst += 8;
+            }
+            else if (format == BLOCK_BC3) {
+                encodeBC4Block(texels, 3, dst);
+                encodeBC1Block(texels, dst + 8);
+                dst += 16;
+            }
+            else if (format == BLOCK_BC4) {
+                encodeBC4Block(texels, 0, dst);
+                dst += 8;
+            }
+        }
+    }
+    return out;
+}
+
+std::vector<unsigned char> DecompressBlocks(BlockFormat format, const unsigned char* blocks,
+    uint32_t width, uint32_t height, uint32_t components)
+{
+    std::vector<unsigned char> out(size_t(width) * height * components);
+    const unsigned char* src = blocks;
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            unsigned char texels[16][4] = {};
+            if (format == BLOCK_BC1) {
+                decodeBC1Block(src, texels);
+                src += 8;
+            }
+            else if (format == BLOCK_BC3) {
+                decodeBC4Block(src, 3, texels);
+                decodeBC1Block(src + 8, texels);
+                src += 16;
+            }
+            else if (format == BLOCK_BC4) {
+                decodeBC4Block(src, 0, texels);
+                src += 8;
+            }
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = bx + i % 4, y = by + i / 4;
+                if (x >= width || y >= height) continue;
+                for (uint32_t c = 0; c < components && c < 4; c++)
+                    out[(size_t(y) * width + x) * components + c] = texels[i][c];
+            }
+        }
+    }
+    return out;
+}
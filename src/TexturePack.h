@@ -0,0 +1,86 @@
+#ifndef TEXTURE_PACK_H
+#define TEXTURE_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Block-compressed payload stored next to the raw levels of a texture.
+enum BlockFormat : uint32_t {
+    BLOCK_NONE = 0,
+    BLOCK_BC1 = 1, // RGB, 8 bytes per 4x4 block (S3TC DXT1)
+    BLOCK_BC3 = 3, // RGBA, 16 bytes per 4x4 block (S3TC DXT5)
+    BLOCK_BC4 = 4  // single channel, 8 bytes per 4x4 block (RGTC1, core since GL 3.0)
+};
+
+struct TextureLevel {
+    uint32_t width;
+    uint32_t height;
+    const unsigned char* pixels;  // tightly packed, `components` bytes per texel
+    size_t pixelBytes;
+    const unsigned char* blocks;  // nullptr when the entry has no block payload
+    size_t blockBytes;
+};
+
+struct TexturePackEntry {
+    std::string name;
+    uint64_t sourceHash;        // FileDigest of the source image
+    uint64_t sourceSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t components;
+    BlockFormat blockFormat;
+    std::vector<TextureLevel> levels;
+};
+
+// Input of TexturePack::Write, owns its level data.
+struct TexturePackSource {
+    std::string name;
+    uint64_t sourceHash;        // FileDigest of the source image
+    uint64_t sourceSize;
+    uint32_t components;
+    BlockFormat blockFormat;
+    std::vector<uint32_t> widths;
+    std::vector<uint32_t> heights;
+    std::vector<std::vector<unsigned char>> pixels;
+    std::vector<std::vector<unsigned char>> blocks;
+};
+
+// One container per textures/ directory, produced offline by TextureTranscoder. Holds every image
+// with its full, pre-filtered mip chain and an optional BCn copy of each level. No GL in here,
+// so the tool and the reader both run on machines without a GPU.
+class TexturePack {
+public:
+    static const uint32_t VERSION = 2;
+
+    static std::string PackPathFor(const std::string& directory);
+
+    bool Open(const std::string& directory);
+    // Returns the entry for fileName if it exists and still matches the source file on disk.
+    const TexturePackEntry* Find(const std::string& fileName) const;
+    const std::vector<TexturePackEntry>& GetEntries() const { return entries; }
+    void Close();
+
+    static bool Write(const std::string& directory, const std::vector<TexturePackSource>& sources);
+
+private:
+    std::string directory;
+    MappedFile file;
+    std::vector<TexturePackEntry> entries;
+};
+
+// Box-filtered mip chain down to 1x1, level 0 included.
+void BuildMipChain(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t components,
+    std::vector<uint32_t>& widths, std::vector<uint32_t>& heights, std::vector<std::vector<unsigned char>>& levels);
+
+BlockFormat BlockFormatFor(uint32_t components);
+size_t BlockBytes(BlockFormat format, uint32_t width, uint32_t height);
+std::vector<unsigned char> CompressBlocks(BlockFormat format, const unsigned char* pixels,
+    uint32_t width, uint32_t height, uint32_t components);
+// Decodes back to `components` bytes per texel, used to verify the encoder.
+std::vector<unsigned char> DecompressBlocks(BlockFormat format, const unsigned char* blocks,
+    uint32_t width, uint32_t height, uint32_t components);
+
+#endif
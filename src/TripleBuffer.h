@@ -0,0 +1,35 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// One writer thread, one reader thread, three slots. The writer fills its own slot and swaps it
+// with the shared one; the reader swaps the shared slot with its own when a newer value is there.
+// Neither side waits on the other, and the slot the reader holds is not touched until its next
+// Read(), so what Read() returns stays valid and unchanged until then.
+template <typename T>
+class TripleBuffer {
+public:
+    // The writer's slot; fill it, then Publish().
+    T& WriteSlot() { return slots[back]; }
+    void Publish() { back = shared.exchange(back | FRESH) & INDEX; }
+
+    // The newest published value, or the one read last time if nothing newer came in.
+    const T& Read()
+    {
+        if (shared.load() & FRESH)
+            front = shared.exchange(front) & INDEX;
+        return slots[front];
+    }
+
+private:
+    static const unsigned int FRESH = 4;
+    static const unsigned int INDEX = 3;
+
+    T slots[3] = {};
+    std::atomic<unsigned int> shared{ 1 };
+    unsigned int back = 0;
+    unsigned int front = 2;
+};
+
+#endif
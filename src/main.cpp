@@ -4,88 +4,111 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Shader.h"
+#include "ShaderVariants.h"
+#include "ProgramCache.h"
+#include "Simulation.h"
 #include "Model.h"
 #include <iostream>
 #include <fstream>
 #include "StreetLamp.h"
-#include "CarHeadlight.h"
 #include "Camera.h"
 #include "Renderer.h"
+#include "TextureLoader.h"
+#include "ModelLoader.h"
+#include "SceneUniforms.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "LightClusters.h"
+#include "DeferredShading.h"
+#include "GpuTimer.h"
+#include "ShadowMaps.h"
+#include "Headless.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <thread>
 
 const unsigned int SCR_WIDTH = 1300;
 const unsigned int SCR_HEIGHT = 900;
 
-enum CameraMode { DEFAULT, TOP, FOLLOW };
-CameraMode activeCamera = DEFAULT;
-Camera topCamera(glm::vec3(0.0f, 20.0f, 10.0f));
-Camera followCamera(glm::vec3(0.0f, 2.0f, 5.0f));
-Camera camera(glm::vec3(0.0f, 2.0f, 10.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
-glm::vec3 carPosition = glm::vec3(55.0f, -1.78f, 1.5f);
-float carRotation = -90.0f;
-enum CarState { MOVING_FORWARD, TURNING_RIGHT, MOVING_FORWARD_AFTER_TURN };
-CarState carState = MOVING_FORWARD;
-bool isNight = false;
-glm::vec3 headlightDirection = glm::vec3(0.0f, -0.3f, 1.0f);
-float headlightIntensity = 0.5f;
+// Ruch myszy od ostatniej klatki; trafia do symulacji razem z klawiszami
+glm::vec2 mouseMovement = glm::vec2(0.0f);
 bool usePhongShading = true;
 bool useBumpMapping = false;
+bool useDeferredShading = false;
+bool useShadowCache = true;
+bool useLightBenchmark = false;
+bool lightBenchmarkToggled = false;
 
+// Glebokosc, do ktorej tna klastry swiatel; dalej i tak jest tylko mgla
+const float LIGHT_CLUSTER_FAR = 300.0f;
+// Ile milisekund klatki moga zajac wysylki modeli i tekstur na GPU
+const double MODEL_UPLOAD_BUDGET_MS = 4.0;
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow* window, float deltaTime);
+void processInput(GLFWwindow* window, SimulationInput& input);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void updateCarMovement(float deltaTime);
+std::vector<Light> benchmarkLights(size_t count);
+unsigned int findNormalMap(const Model& model);
+void benchmarkLightBinning(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, unsigned int threads);
 
-int main()
+int main(int argc, char** argv)
 {
-    GLFWwindow* window = Renderer::Initialize();
-    if (!window) return -1;
+    HeadlessOptions headless;
+    if (!HeadlessOptions::Parse(argc, argv, headless)) return -1;
+    if (headless.tangentBenchmark) return Model::BenchmarkTangents("models/sphere/scene.gltf", 100) ? 0 : -1;
 
-
-    float deltaTime = 0.0f;
-    float lastFrame = 0.0f;
-
-    Shader shader("shaders/vertex_shader.glsl", "shaders/fragment_shader.glsl");
-    Model carmodel("models/car/scene.gltf");
-    Model cityModel("models/city/scene.gltf");
-    Model sphere("models/sphere/scene.gltf");
-    Model sphere_tank("models/sphere_tank/scene.gltf");
-
-    unsigned int carNormalMap = 0;
-    unsigned int cityNormalMap = 0;
-    unsigned int sphereNormalMap = 0;
-    unsigned int sphereTankNormalMap = 0;
-
-    for (Texture tex : carmodel.GetMeshes()[0].textures) {
-        if (tex.type == "texture_normal") {
-            carNormalMap = tex.id;
-            break;
-        }
-    }
-
-    for (Texture tex : cityModel.GetMeshes()[0].textures) {
-        if (tex.type == "texture_normal") {
-            cityNormalMap = tex.id;
-            break;
-        }
+    GLFWwindow* window = nullptr;
+    if (headless.enabled) {
+        if (!Renderer::InitializeHeadless(window)) return -1;
     }
-
-    for (Texture tex : sphere.GetMeshes()[0].textures) {
-        if (tex.type == "texture_normal") {
-            sphereNormalMap = tex.id;
-            break;
-        }
+    else {
+        window = Renderer::Initialize();
+        if (!window) return -1;
     }
-
-    for (Texture tex : sphere_tank.GetMeshes()[0].textures) {
-        if (tex.type == "texture_normal") {
-            sphereTankNormalMap = tex.id;
-            break;
-        }
+    const float renderWidth = headless.enabled ? static_cast<float>(headless.width) : static_cast<float>(SCR_WIDTH);
+    const float renderHeight = headless.enabled ? static_cast<float>(headless.height) : static_cast<float>(SCR_HEIGHT);
+
+
+    // Shadery kompiluja sie rownolegle (jesli sterownik pozwala) az do Finish; binaria z shader_cache/
+    auto shaderStart = std::chrono::steady_clock::now();
+    Shader deferredLightingShader("shaders/fullscreen_vertex.glsl", "shaders/deferred_lighting.glsl", {}, true);
+    Shader shadowShader("shaders/shadow_vertex.glsl", "shaders/shadow_fragment.glsl", {}, true);
+    // Modele wczytuja sie w tle; kazdy trafia do sceny w pierwszej klatce, w ktorej jest gotowy
+    ModelHandle carHandle = ModelLoader::Get().Load("models/car/scene.gltf");
+    ModelHandle cityHandle = ModelLoader::Get().Load("models/city/scene.gltf");
+    ModelHandle sphereHandle = ModelLoader::Get().Load("models/sphere/scene.gltf");
+    ModelHandle sphereTankHandle = ModelLoader::Get().Load("models/sphere_tank/scene.gltf");
+    Model* carmodel = nullptr;
+    Model* cityModel = nullptr;
+    Model* sphere = nullptr;
+    Model* sphere_tank = nullptr;
+
+    // Scena: modele podpiete pod graf, ich wlasne wezly z pliku pod spodem
+    SceneGraph scene;
+    int carNode = SceneGraph::NO_PARENT;
+    glm::vec3 carPivot = glm::vec3(0.0f);
+
+    // Benchmark: kopie miasta w siatce obok oryginalu i dodatkowe auta na ich ulicach
+    const BenchmarkOptions& benchmark = headless.benchmark;
+    std::vector<glm::vec3> cityOffsets(1, glm::vec3(0.0f));
+    std::vector<int> extraCarNodes;
+    if (benchmark.enabled) {
+        useDeferredShading = benchmark.deferred;
+        useLightBenchmark = benchmark.lights > 0;
     }
+    const std::vector<CameraPath> benchmarkPaths = BenchmarkPaths();
+    const int warmupFrames = std::min(10, headless.frames / 4);
+    const int totalFrames = headless.frames * (benchmark.enabled ? static_cast<int>(benchmarkPaths.size()) : 1);
+    BenchmarkReport benchmarkReport;
 
     StreetLamp streetLamp(glm::vec3(-5.7f, 2.3f, 5.4f),
         glm::vec3(0.0f, -1.0f, 0.0f),
@@ -95,192 +118,474 @@ int main()
         glm::cos(glm::radians(35.5f)),
         3.0);
 
-    CarHeadlight leftHeadlight(
-        glm::vec3(carPosition.x - 0.4f, carPosition.y + 0.2f, carPosition.z + 1.0f),
-        glm::vec3(0.0f, -0.2f, 1.0f),
-        glm::vec3(0.9f, 0.85f, 0.7f),
-        10.5f,
-        glm::cos(glm::radians(16.0f)),
-        glm::cos(glm::radians(22.0f)),
-        8.0f
-    );
-    CarHeadlight rightHeadlight(
-        glm::vec3(carPosition.x + 0.4f, carPosition.y + 0.2f, carPosition.z + 1.0f),
-        glm::vec3(0.0f, -0.2f, 1.0f),
-        glm::vec3(0.9f, 0.85f, 0.7f),
-        10.5f,
-        glm::cos(glm::radians(16.0f)),
-        glm::cos(glm::radians(22.0f)),
-        8.0f
-    );
-
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000000.0f);
-
-    while (!glfwWindowShouldClose(window))
-    {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        processInput(window, deltaTime);
-        updateCarMovement(deltaTime);
+    glm::mat4 projection = glm::perspective(glm::radians(ZOOM), renderWidth / renderHeight, 0.1f, 1000000.0f);
+
+    deferredLightingShader.Finish();
+    shadowShader.Finish();
+    SceneUniforms sceneUniforms;
+    sceneUniforms.Attach(deferredLightingShader);
+    RenderQueue renderQueue;
+
+    // Swiatla punktowe: przydzial do klastrow na watku glownym i pomocnikach
+    unsigned int lightThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    LightClusters lightClusters(std::min(lightThreads, 7u));
+    lightClusters.SetProjection(projection, 0.1f, LIGHT_CLUSTER_FAR);
+    lightClusters.Attach(deferredLightingShader);
+
+    // Tryb odroczony (klawisz F): G-buffer + jedno przejscie oswietlenia
+    DeferredShading deferredShading;
+    deferredShading.Attach(deferredLightingShader);
+    GpuTimer sceneTimer;
+
+    // Cienie slonca: statyczna mapa miasta z pamieci podrecznej + mala warstwa auta co klatke
+    ShadowMaps shadowMaps;
+    shadowMaps.Attach(deferredLightingShader);
+
+    // Warianty shaderow sceny (G/B, mgla): kazdy kompilowany przy pierwszym uzyciu
+    auto setupSceneShader = [&](Shader& variant) {
+        sceneUniforms.Attach(variant);
+        lightClusters.Attach(variant);
+        shadowMaps.Attach(variant);
+        variant.use();
+        variant.setInt("textureNormal", 1);
+    };
+    ShaderVariants sceneShaders("shaders/vertex_shader.glsl", "shaders/fragment_shader.glsl",
+        SHADER_PHONG | SHADER_BUMP_MAPPING | SHADER_FOG, setupSceneShader);
+    ShaderVariants gbufferShaders("shaders/vertex_shader.glsl", "shaders/gbuffer_fragment.glsl",
+        SHADER_PHONG | SHADER_BUMP_MAPPING, setupSceneShader);
+    // Wszystkie warianty dostepne klawiszami G/B od razu, zeby przelaczanie nie zacinalo
+    std::vector<unsigned int> shaderKeys;
+    for (bool phong : { false, true })
+        for (bool bump : { false, true })
+            shaderKeys.push_back(ShaderKey(phong, bump, true));
+    sceneShaders.Prepare(shaderKeys);
+    gbufferShaders.Prepare(shaderKeys);
+    std::cout << "Shaders ready in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count()
+        << " ms (" << ProgramCache::Get().Hits() << " from cache, " << ProgramCache::Get().Misses() << " compiled)" << std::endl;
+    RenderQueue shadowQueue;
+    std::vector<Light> manyLights = benchmarkLights(benchmark.enabled ? benchmark.lights : 1000);
+    std::vector<Light> lights;
+    unsigned int frameIndex = 0;
+    unsigned int framesWithAllModels = 0;
+    float lastTitleUpdate = 0.0f;
+
+    // Symulacja (auto, kamery, reflektory) na wlasnym watku ze stalym krokiem; bez okna krok na
+    // klatke na tym watku, zeby kolejne uruchomienia dawaly te same klatki
+    Simulation simulation;
+    SimulationInput input;
+    Simulation::Stats lastSimulationStats;
+    double renderMsTotal = 0.0, titleRenderMs = 0.0;
+    int titleFrames = 0;
+
+    // Bez okna: klatki ida do bufora poza ekranem, a stamtad do PNG
+    std::unique_ptr<OffscreenTarget> offscreen;
+    int renderedFrames = 0;
+    if (headless.enabled) {
+        offscreen = std::make_unique<OffscreenTarget>(headless.width, headless.height);
+        if (!offscreen->IsComplete()) {
+            Renderer::Shutdown();
+            return -1;
+        }
+        std::error_code error;
+        if (headless.saveFrames)
+            std::filesystem::create_directories(headless.outputDirectory, error);
+        if (error) {
+            std::cout << "ERROR::HEADLESS::CANNOT_CREATE_DIRECTORY " << headless.outputDirectory << ": " << error.message() << std::endl;
+            Renderer::Shutdown();
+            return -1;
+        }
+        // Pierwsza klatka ma miec juz wszystkie modele i tekstury
+        ModelLoader::Get().Finish();
+        TextureLoader::Get().Finish();
+    }
+    else {
+        simulation.Start();
+    }
 
+    while (headless.enabled ? renderedFrames < totalFrames : !glfwWindowShouldClose(window))
+    {
+        PROFILE_BEGIN_FRAME();
+        auto frameStart = std::chrono::steady_clock::now();
+        Shader::ResetLookupCounters();
+
+        float currentFrame = headless.enabled ? renderedFrames / 60.0f : static_cast<float>(glfwGetTime());
+        if (!headless.enabled) {
+            PROFILE_SCOPE("Input");
+            processInput(window, input);
+            simulation.PushInput(input);
+        }
+        else {
+            PROFILE_SCOPE("Simulation step");
+            simulation.Step();
+        }
+        // Stan miedzy dwoma ostatnimi krokami symulacji, niezmienny do konca klatki
+        const SimulationState sim = simulation.Sample();
+        auto renderStart = std::chrono::steady_clock::now();
+
+        // Modele i tekstury wczytane w tle, w ramach budzetu klatki
+        {
+            PROFILE_GPU_SCOPE("Model uploads");
+            ModelLoader::Get().Update(MODEL_UPLOAD_BUDGET_MS);
+        }
+        {
+            PROFILE_GPU_SCOPE("Texture uploads");
+            TextureLoader::Get().UploadReady(TEXTURE_UPLOAD_BUDGET_MS);
+        }
 
+        // Obrot miasta o 90 stopni pochodzi z wezlow pliku
+        if (!cityModel && cityHandle.Ready()) {
+            cityModel = cityHandle.Get();
+            cityModel->SetNormalMap(findNormalMap(*cityModel));
+            int cityNode = cityModel->AttachTo(scene);
+            scene.SetLocal(cityNode, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -2.0f, 0.0f)));
+            if (benchmark.enabled) {
+                scene.Update();
+                AABB cityBounds = cityModel->WorldBounds();
+                glm::vec3 cityStep = cityBounds.max - cityBounds.min;
+                int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(benchmark.cityCopies))));
+                for (int copy = 1; copy < benchmark.cityCopies; copy++) {
+                    glm::vec3 offset((copy % columns) * cityStep.x, 0.0f, (copy / columns) * cityStep.z);
+                    int copyNode = cityModel->AttachTo(scene);
+                    scene.SetLocal(copyNode, glm::translate(glm::mat4(1.0f), offset + glm::vec3(0.0f, -2.0f, 0.0f)));
+                    cityOffsets.push_back(offset);
+                }
+            }
+            shadowMaps.Invalidate();
+        }
+        if (!sphere && sphereHandle.Ready()) {
+            sphere = sphereHandle.Get();
+            sphere->SetNormalMap(findNormalMap(*sphere));
+            glm::mat4 sphereModelMat = glm::mat4(1.0f);
+            sphereModelMat = glm::translate(sphereModelMat, glm::vec3(0.0f, 5.0f, 0.0f));
+            sphereModelMat = glm::scale(sphereModelMat, glm::vec3(1.5f, 1.5f, 1.5f));
+            sphereModelMat = glm::scale(sphereModelMat, glm::vec3(0.1f, 0.1f, 0.1f));
+            scene.SetLocal(sphere->AttachTo(scene), sphereModelMat);
+            shadowMaps.Invalidate();
+        }
+        if (!sphere_tank && sphereTankHandle.Ready()) {
+            sphere_tank = sphereTankHandle.Get();
+            sphere_tank->SetNormalMap(findNormalMap(*sphere_tank));
+            glm::mat4 sphereTankModelMat = glm::mat4(1.0f);
+            sphereTankModelMat = glm::translate(sphereTankModelMat, glm::vec3(-8.0f, 5.0f, 0.0f));
+            sphereTankModelMat = glm::scale(sphereTankModelMat, glm::vec3(0.8f, 0.8f, 0.8f));
+            scene.SetLocal(sphere_tank->AttachTo(scene), sphereTankModelMat);
+            shadowMaps.Invalidate();
+        }
+        // W pliku auto stoi z dala od poczatku ukladu; obracamy je wokol jego wlasnego srodka.
+        // Miasto jest wczesniej, wiec dodatkowe auta maja juz swoje kopie miasta.
+        if (!carmodel && carHandle.Ready()) {
+            carmodel = carHandle.Get();
+            carmodel->SetNormalMap(findNormalMap(*carmodel));
+            carNode = carmodel->AttachTo(scene);
+            carPivot = glm::vec3(carmodel->GetMeshTransform(0)[3]);
+            for (int car = 1; car < benchmark.cars; car++)
+                extraCarNodes.push_back(carmodel->AttachTo(scene));
+        }
 
-        isNight ? glClearColor(0.02f, 0.02f, 0.1f, 1.0f) : glClearColor(0.6f, 0.8f, 1.0f, 1.0f);
+        sim.isNight ? glClearColor(0.02f, 0.02f, 0.1f, 1.0f) : glClearColor(0.6f, 0.8f, 1.0f, 1.0f);
+        if (offscreen)
+            offscreen->Bind();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        shader.use();
-        shader.setInt("textureNormal", 1);
-        shader.setBool("useBumpMapping", useBumpMapping);
-        shader.setInt("shadingMode", usePhongShading ? 1 : 0);
-        shader.setMat4("projection", projection);
-
-        if (isNight) {
-            glm::vec3 lightColor = glm::vec3(0.2f, 0.2f, 0.5f);
-            glm::vec3 ambientColor = glm::vec3(0.1f, 0.1f, 0.1f);
-            glm::vec3 lightDirection = glm::vec3(0.1f, -1.0f, 0.2f);
-            shader.setVec3("lightDir", lightDirection);
-            shader.setVec3("lightColor", lightColor);
-            shader.setVec3("ambientColor", ambientColor);
+        SceneUniformData sceneData = {};
 
+        if (sim.isNight) {
+            sceneData.lights.lightColor = glm::vec3(0.2f, 0.2f, 0.5f);
+            sceneData.lights.ambientColor = glm::vec3(0.1f, 0.1f, 0.1f);
+            sceneData.lights.lightDir = glm::vec3(0.1f, -1.0f, 0.2f);
         }
         else {
-            glm::vec3 lightColor = glm::vec3(1.2f, 1.1f, 0.9f);
-            glm::vec3 ambientColor = glm::vec3(0.7f, 0.7f, 0.7f);
-            glm::vec3 lightDirection = glm::vec3(-0.2f, -1.0f, -0.3f);
-
-            shader.setVec3("lightDir", lightDirection);
-            shader.setVec3("lightColor", lightColor);
-            shader.setVec3("ambientColor", ambientColor);
+            sceneData.lights.lightColor = glm::vec3(1.2f, 1.1f, 0.9f);
+            sceneData.lights.ambientColor = glm::vec3(0.7f, 0.7f, 0.7f);
+            sceneData.lights.lightDir = glm::vec3(-0.2f, -1.0f, -0.3f);
         }
 
         // latarina
-        if (isNight) {
-            shader.setVec3("streetLight.position", streetLamp.position);
-            shader.setVec3("streetLight.direction", streetLamp.direction);
-            shader.setVec3("streetLight.color", streetLamp.color * streetLamp.intensity);
-            shader.setFloat("streetLight.cutoff", streetLamp.cutoff);
-            shader.setFloat("streetLight.outerCutoff", streetLamp.outerCutoff);
-            shader.setFloat("streetLight.radius", streetLamp.radius);
-        }
-        else {
-            shader.setVec3("streetLight.color", glm::vec3(0.0f));
+        lights.clear();
+        if (sim.isNight) {
+            lights.push_back(streetLamp.ToLight());
         }
 
         // reflektory
+        lights.push_back(sim.headlights[0]);
+        lights.push_back(sim.headlights[1]);
 
-        glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(carRotation), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::vec3 transformedHeadlightDirection = glm::vec3(rotationMatrix * glm::vec4(headlightDirection, 0.0f));
-
-        glm::vec3 headlightOffsetLeft = glm::vec3(1.2f, 0.3f, -5.2f);
-        glm::vec3 headlightOffsetRight = glm::vec3(2.2f, 0.3f, -5.2f);
-        leftHeadlight.position = carPosition + glm::vec3(rotationMatrix * glm::vec4(headlightOffsetLeft, 1.0f));
-        rightHeadlight.position = carPosition + glm::vec3(rotationMatrix * glm::vec4(headlightOffsetRight, 1.0f));
+        // Test wydajnosci: 1000 latarni nad miastem (klawisz L)
+        if (useLightBenchmark)
+            lights.insert(lights.end(), manyLights.begin(), manyLights.end());
 
-        leftHeadlight.direction = glm::normalize(transformedHeadlightDirection);
-        rightHeadlight.direction = glm::normalize(transformedHeadlightDirection);
-        leftHeadlight.intensity = headlightIntensity;
-        rightHeadlight.intensity = headlightIntensity;
 
-        shader.setVec3("headlightLeft.position", leftHeadlight.position);
-        shader.setVec3("headlightLeft.direction", leftHeadlight.direction);
-        shader.setVec3("headlightLeft.color", leftHeadlight.color* leftHeadlight.intensity);
-        shader.setFloat("headlightLeft.cutoff", leftHeadlight.cutoff);
-        shader.setFloat("headlightLeft.outerCutoff", leftHeadlight.outerCutoff);
-        shader.setFloat("headlightLeft.radius", leftHeadlight.radius);
+        // Kamera
+        glm::mat4 view;
+        if (benchmark.enabled) {
+            // Kazda sciezka dostaje headless.frames klatek; pierwsze warmupFrames nie sa liczone
+            const CameraPath& path = benchmarkPaths[renderedFrames / headless.frames];
+            int pathFrame = renderedFrames % headless.frames;
+            if (pathFrame == 0)
+                benchmarkReport.BeginPath(path.Name());
+            if (pathFrame == warmupFrames)
+                benchmarkReport.EndWarmup();
+            glm::vec3 pathPosition, pathTarget;
+            path.Sample(headless.frames > 1 ? pathFrame / static_cast<float>(headless.frames - 1) : 0.0f, pathPosition, pathTarget);
+            view = glm::lookAt(pathPosition, pathTarget, glm::vec3(0.0f, 1.0f, 0.0f));
+            sceneData.frame.viewPos = pathPosition;
+        }
+        else {
+            view = sim.ViewMatrix();
+            sceneData.frame.viewPos = sim.viewPosition;
+        }
+        sceneData.frame.view = view;
+        sceneData.frame.projection = projection;
 
-        shader.setVec3("headlightRight.position", rightHeadlight.position);
-        shader.setVec3("headlightRight.direction", rightHeadlight.direction);
-        shader.setVec3("headlightRight.color", rightHeadlight.color* rightHeadlight.intensity);
-        shader.setFloat("headlightRight.cutoff", rightHeadlight.cutoff);
-        shader.setFloat("headlightRight.outerCutoff", rightHeadlight.outerCutoff);
-        shader.setFloat("headlightRight.radius", rightHeadlight.radius);
+        // mgła
+        if (sim.isNight) {
+            sceneData.frame.fogDensity = 0.035f;
+            sceneData.frame.fogColor = glm::vec3(0.1f, 0.1f, 0.2f);
+        }
+        else {
+            sceneData.frame.fogDensity = 0.02f;
+            sceneData.frame.fogColor = glm::vec3(0.6f, 0.7f, 0.8f);
+        }
 
+        int framebufferWidth = headless.width, framebufferHeight = headless.height;
+        if (!headless.enabled)
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (lightBenchmarkToggled) {
+            if (useLightBenchmark)
+                benchmarkLightBinning(lights, view, projection, lightClusters.ThreadCount());
+            lightBenchmarkToggled = false;
+        }
+        {
+            PROFILE_GPU_SCOPE("Light clusters");
+            lightClusters.Build(lights, view);
+            lightClusters.Upload();
+            lightClusters.FillUniforms(sceneData.lights, static_cast<float>(framebufferWidth), static_cast<float>(framebufferHeight));
+        }
 
-        // Kamera
-        glm::mat4 view;
-        if (activeCamera == TOP) {
-            glm::vec3 topViewPosition = glm::vec3(-68.0f, 12.0f, -11.0f);
-            glm::vec3 upDirection(0.0f, 1.0f, 0.0f);
+        // Samochód: jedyny ruchomy wezel, Update przelicza tylko jego poddrzewo
+        glm::mat4 carModelMat = glm::mat4(1.0f);
+        carModelMat = glm::translate(carModelMat, sim.carPosition);
+        carModelMat = glm::scale(carModelMat, glm::vec3(0.1f, 0.1f, 0.1f));
+        carModelMat = glm::rotate(carModelMat, glm::radians(sim.carRotation), glm::vec3(0.0f, 1.0f, 0.0f));
+        carModelMat = glm::translate(carModelMat, -carPivot);
+        if (carmodel)
+            scene.SetLocal(carNode, carModelMat);
+        for (size_t car = 0; car < extraCarNodes.size(); car++) {
+            // Dodatkowe auta jada prosto ta sama ulica co 10 jednostek, po kolei w kopiach miasta
+            float distance = std::fmod(static_cast<float>(sim.time) * 6.0f + 10.0f * (car + 1), 118.5f);
+            glm::vec3 position = glm::vec3(55.0f - distance, sim.carPosition.y, 1.5f) + cityOffsets[(car + 1) % cityOffsets.size()];
+            glm::mat4 extraCarMat = glm::translate(glm::mat4(1.0f), position);
+            extraCarMat = glm::scale(extraCarMat, glm::vec3(0.1f, 0.1f, 0.1f));
+            extraCarMat = glm::rotate(extraCarMat, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            extraCarMat = glm::translate(extraCarMat, -carPivot);
+            scene.SetLocal(extraCarNodes[car], extraCarMat);
+        }
+        size_t updatedNodes;
+        {
+            PROFILE_SCOPE("Scene graph");
+            updatedNodes = scene.Update();
+        }
 
-            view = glm::lookAt(topViewPosition, carPosition, upDirection);
-            shader.setVec3("viewPos", topViewPosition);
+        // Cienie: mapa statyczna tylko po zmianie kierunku swiatla (albo co klatke, gdy cache wylaczony klawiszem H)
+        CullStats shadowCullStats;
+        glm::vec3 sunDirection = sceneData.lights.lightDir;
+        bool staticShadowsRendered = !useShadowCache || shadowMaps.NeedsStaticUpdate(sunDirection);
+        if (staticShadowsRendered) {
+            PROFILE_GPU_SCOPE("Static shadows");
+            // Dopoki nic statycznego nie jest wczytane, mapa zostaje pusta
+            AABB staticBounds = { glm::vec3(-1.0f), glm::vec3(1.0f) };
+            bool anyStatic = false;
+            for (const Model* model : { cityModel, sphere, sphere_tank }) {
+                if (!model)
+                    continue;
+                AABB box = model->WorldBounds();
+                staticBounds.min = anyStatic ? glm::min(staticBounds.min, box.min) : box.min;
+                staticBounds.max = anyStatic ? glm::max(staticBounds.max, box.max) : box.max;
+                anyStatic = true;
+            }
+            shadowMaps.BeginStatic(shadowQueue, sunDirection, staticBounds);
+            for (Model* model : { cityModel, sphere, sphere_tank }) {
+                if (model)
+                    model->SubmitShadowCasters(shadowQueue, shadowShader, shadowCullStats);
+            }
+            shadowMaps.RenderStatic(shadowQueue, shadowShader);
+        }
+        {
+            PROFILE_GPU_SCOPE("Dynamic shadows");
+            // Warstwa obejmuje tylko glowne auto; przy --cars cala siatka miast dalaby zbyt grube teksele
+            AABB carBounds = carmodel ? carmodel->WorldBounds(carNode) : AABB{ sim.carPosition - glm::vec3(1.0f), sim.carPosition + glm::vec3(1.0f) };
+            shadowMaps.BeginDynamic(shadowQueue, sunDirection, carBounds);
+            if (carmodel)
+                carmodel->SubmitShadowCasters(shadowQueue, shadowShader, shadowCullStats);
+            shadowMaps.RenderDynamic(shadowQueue, shadowShader);
         }
+        shadowMaps.Bind();
+        shadowMaps.FillUniforms(sceneData.lights);
 
-        else if (activeCamera == FOLLOW) {
-            glm::vec3 defaultOffset(13.0f, 2.0f, 1.8f);
-            float deltaAngle = glm::radians(carRotation - (-90.0f));
-            glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), deltaAngle, glm::vec3(0.0f, 1.0f, 0.0f));
-            glm::vec3 rotatedOffset = glm::vec3(rotationMatrix * glm::vec4(defaultOffset, 1.0f));
-            glm::vec3 followViewPosition = carPosition + rotatedOffset;
-            glm::vec3 upDirection(0.0f, 1.0f, 0.0f);
-            view = glm::lookAt(followViewPosition, carPosition, upDirection);
-            followCamera.Position = followViewPosition;
-            followCamera.Up = upDirection;
+        {
+            PROFILE_GPU_SCOPE("Uniform upload");
+            sceneUniforms.Upload(sceneData);
+        }
+        renderQueue.Begin(view, projection, 1000.0f, static_cast<float>(framebufferHeight));
+        unsigned int shaderKey = ShaderKey(usePhongShading, useBumpMapping, sceneData.frame.fogDensity > 0.0f);
+        Shader& shader = sceneShaders.Get(shaderKey);
+        Shader& gbufferShader = gbufferShaders.Get(shaderKey);
+        CullStats cullStats;
+        LodStats lodStats;
+
+        // Modele trafiaja do kolejki; rysowane sa dopiero razem, posortowane
+        if (cityModel) {
+            PROFILE_SCOPE("Submit city");
+            cityModel->Submit(renderQueue, shader, cullStats, lodStats);
+        }
+        if (sphere) {
+            PROFILE_SCOPE("Submit sphere");
+            sphere->Submit(renderQueue, shader, cullStats, lodStats);
+        }
+        if (sphere_tank) {
+            PROFILE_SCOPE("Submit sphere tank");
+            sphere_tank->Submit(renderQueue, shader, cullStats, lodStats);
+        }
+        if (carmodel) {
+            PROFILE_SCOPE("Submit car");
+            carmodel->Submit(renderQueue, shader, cullStats, lodStats);
+        }
 
-            shader.setVec3("viewPos", followViewPosition);
+        // Czas GPU sceny, do porownania obu sciezek
+        sceneTimer.Begin();
+        bool deferredFrame = useDeferredShading && deferredShading.Resize(framebufferWidth, framebufferHeight);
+        if (deferredFrame) {
+            PROFILE_GPU_SCOPE("Draw deferred");
+            renderQueue.Prepare();
+            {
+                PROFILE_GPU_SCOPE("G-buffer");
+                deferredShading.BeginGeometry();
+                renderQueue.ExecuteLayer(RenderQueue::Opaque, &gbufferShader);
+            }
+            {
+                PROFILE_GPU_SCOPE("Lighting");
+                deferredShading.Light(deferredLightingShader, glm::inverse(projection * view));
+            }
+            {
+                PROFILE_GPU_SCOPE("Transparent");
+                renderQueue.ExecuteLayer(RenderQueue::Transparent);
+            }
         }
         else {
-            view = camera.GetViewMatrix();
-            shader.setVec3("viewPos", camera.Position);
+            PROFILE_GPU_SCOPE("Draw forward");
+            renderQueue.Prepare();
+            {
+                PROFILE_GPU_SCOPE("Opaque");
+                renderQueue.ExecuteLayer(RenderQueue::Opaque);
+            }
+            {
+                PROFILE_GPU_SCOPE("Transparent");
+                renderQueue.ExecuteLayer(RenderQueue::Transparent);
+            }
+        }
+        sceneTimer.End();
+        // Czas CPU renderowania, bez kroku symulacji i bez Swap/zapisu PNG
+        double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+        renderMsTotal += renderMs;
+        titleRenderMs += renderMs;
+        titleFrames++;
+
+        // Culling: licznik w tytule okna, raz na sekunde
+        const ShadowMaps::Stats& shadowStats = shadowMaps.GetStats();
+        if (!headless.enabled && currentFrame - lastTitleUpdate >= 1.0f) {
+            std::string title = "Model Loader | meshes drawn " + std::to_string(cullStats.drawn) + ", culled " +
+                std::to_string(cullStats.culled) + ", box tests " + std::to_string(cullStats.tested) +
+                " | tris " + std::to_string(lodStats.triangles) + " of " + std::to_string(lodStats.fullTriangles) +
+                " | lights " + std::to_string(lightClusters.GetStats().binnedLights) + " of " + std::to_string(lightClusters.GetStats().lights) +
+                ", refs " + std::to_string(lightClusters.GetStats().references) + ", bin " + std::to_string(lightClusters.GetStats().binMs) + " ms" +
+                " | " + (useDeferredShading ? "deferred" : "forward") + " gpu " + std::to_string(sceneTimer.LastMs()) + " ms" +
+                " | shadows dynamic " + std::to_string(shadowStats.dynamicGpuMs) + " ms, static " + std::to_string(shadowStats.staticGpuMs) +
+                " ms " + (useShadowCache ? "cached" : "every frame");
+            Simulation::Stats simulationStats = simulation.GetStats();
+            uint64_t ticks = simulationStats.ticks - lastSimulationStats.ticks;
+            double tickMs = ticks ? (simulationStats.totalStepMs - lastSimulationStats.totalStepMs) / ticks : 0.0;
+            title += " | sim " + std::to_string(ticks) + " ticks, " + std::to_string(tickMs) + " ms/tick | render " +
+                std::to_string(titleRenderMs / titleFrames) + " ms/frame";
+            glfwSetWindowTitle(window, title.c_str());
+            lastTitleUpdate = currentFrame;
+            lastSimulationStats = simulationStats;
+            titleRenderMs = 0.0;
+            titleFrames = 0;
         }
-        shader.setMat4("view", view);
 
-        // mgła
-        if (isNight) {
-            shader.setFloat("fogDensity", 0.035f);
-            shader.setVec3("fogColor", glm::vec3(0.1f, 0.1f, 0.2f));
+        // Druga klatka ze wszystkimi modelami: handle z pierwszej (samplery meshy) sa juz rozwiazane,
+        // a w oknie modele doczytuja sie jeszcze przez pierwsze klatki
+        frameIndex++;
+        if (ModelLoader::Get().Pending() == 0 && framesWithAllModels++ == 1) {
+            const Shader::LookupCounters& lookups = Shader::Counters();
+            std::cout << "Uniform lookups per frame: " << lookups.driver << " glGetUniformLocation, "
+                << lookups.byName << " by name (hashed), " << lookups.byHandle << " via handles; without the cache every one of the "
+                << lookups.byName + lookups.byHandle << " sets was a glGetUniformLocation call" << std::endl;
+            const RenderQueue::Stats& queueStats = renderQueue.GetStats();
+            std::cout << "Render queue: " << queueStats.commands << " commands, " << queueStats.programChanges << " program changes, "
+                << queueStats.materialChanges << " material changes, " << queueStats.vaoBinds << " VAO binds, "
+                << queueStats.instancedDraws << " instanced draws covering " << queueStats.instances << " instances" << std::endl;
+            std::cout << "Culling: " << cullStats.drawn << " meshes drawn, " << cullStats.culled << " culled, "
+                << cullStats.tested << " individual box tests" << std::endl;
+            std::cout << "LOD: " << lodStats.triangles << " of " << lodStats.fullTriangles << " triangles, meshes per level";
+            for (size_t count : lodStats.meshes)
+                std::cout << " " << count;
+            std::cout << std::endl;
+            std::cout << "Scene graph: " << updatedNodes << " of " << scene.Size() << " world matrices recomputed" << std::endl;
+            std::cout << "Shadows: static layer " << shadowStats.staticDraws << " draws, " << shadowStats.staticCpuMs << " ms CPU / "
+                << shadowStats.staticGpuMs << " ms GPU per rebuild (" << shadowStats.staticRenders << " so far); dynamic layer "
+                << shadowStats.dynamicDraws << " draws, " << shadowStats.dynamicCpuMs << " ms CPU / " << shadowStats.dynamicGpuMs
+                << " ms GPU every frame" << std::endl;
+        }
+
+        if (benchmark.enabled) {
+            // Czas klatki razem z GPU; rysowania: scena, cienie i pelnoekranowe swiatlo deferred
+            glFinish();
+            double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            size_t drawCalls = renderQueue.GetStats().commands + shadowStats.dynamicDraws +
+                (staticShadowsRendered ? shadowStats.staticDraws : 0) + (deferredFrame ? 1 : 0);
+            benchmarkReport.AddFrame(frameMs, drawCalls, lodStats.triangles);
+        }
+
+        if (offscreen) {
+            if (headless.saveFrames) {
+                PROFILE_SCOPE("Save PNG");
+                char name[32];
+                std::snprintf(name, sizeof(name), "frame_%04d.png", renderedFrames);
+                const std::string path = (std::filesystem::path(headless.outputDirectory) / name).string();
+                if (offscreen->SavePng(path))
+                    std::cout << "Saved " << path << std::endl;
+            }
+            renderedFrames++;
         }
         else {
-            shader.setFloat("fogDensity", 0.02f);
-            shader.setVec3("fogColor", glm::vec3(0.6f, 0.7f, 0.8f));
-        }
-        
-        // Miasto
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, cityNormalMap);
-        glm::mat4 cityModelMat = glm::mat4(1.0f);
-        cityModelMat = glm::translate(cityModelMat, glm::vec3(0.0f, -2.0f, 0.0f));
-        cityModelMat = glm::rotate(cityModelMat, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        shader.setMat4("model", cityModelMat);
-        cityModel.Draw(shader);
-
-        // Kula
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, sphereNormalMap);
-        glm::mat4 sphereModelMat = glm::mat4(1.0f);
-        sphereModelMat = glm::translate(sphereModelMat, glm::vec3(0.0f, 5.0f, 0.0f));
-        sphereModelMat = glm::scale(sphereModelMat, glm::vec3(1.5f, 1.5f, 1.5f));
-        sphereModelMat = glm::scale(sphereModelMat, glm::vec3(0.1f, 0.1f, 0.1f));
-        shader.setMat4("model", sphereModelMat);
-        sphere.Draw(shader);
-
-
-        // Kula Tank
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, sphereTankNormalMap);
-        glm::mat4 sphereTankModelMat = glm::mat4(1.0f);
-        sphereTankModelMat = glm::translate(sphereTankModelMat, glm::vec3(-8.0f, 5.0f, 0.0f));
-        sphereTankModelMat = glm::scale(sphereTankModelMat, glm::vec3(0.8f, 0.8f, 0.8f));
-        shader.setMat4("model", sphereTankModelMat);
-        sphere_tank.Draw(shader);
-
-        // Samochód
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, carNormalMap);
-        glm::mat4 carModelMat = glm::mat4(1.0f);
-        carModelMat = glm::translate(carModelMat, carPosition);
-        carModelMat = glm::scale(carModelMat, glm::vec3(0.1f, 0.1f, 0.1f));
-        carModelMat = glm::rotate(carModelMat, glm::radians(carRotation), glm::vec3(0.0f, 1.0f, 0.0f));
-        shader.setMat4("model", carModelMat);
-        carmodel.Draw(shader);
+            {
+                PROFILE_SCOPE("Swap");
+                glfwSwapBuffers(window);
+            }
+            glfwPollEvents();
+        }
+        PROFILE_END_FRAME();
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    simulation.Stop();
+    Simulation::Stats simulationStats = simulation.GetStats();
+    std::cout << "Simulation: " << simulationStats.ticks << " ticks at " << Simulation::TICK_RATE << " Hz "
+        << (headless.enabled ? "on the render thread" : "on its own thread") << ", "
+        << (simulationStats.ticks ? simulationStats.totalStepMs / simulationStats.ticks : 0.0) << " ms/tick (max "
+        << simulationStats.maxStepMs << " ms), " << simulationStats.skips << " catch-up skips; render: " << frameIndex
+        << " frames, " << (frameIndex ? renderMsTotal / frameIndex : 0.0) << " ms/frame CPU" << std::endl;
+
+    // Bez okna nie ma klawisza P; podsumowanie (bez ostatnich klatek w locie) na koniec
+    if (headless.enabled)
+        PROFILE_PRINT_SUMMARY();
+    if (benchmark.enabled) {
+        benchmarkReport.Print();
+        benchmarkReport.Write(benchmark.reportPath, benchmark, headless.width, headless.height, headless.frames, warmupFrames,
+            reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
     }
 
-    glfwTerminate();
+    Renderer::Shutdown();
     return 0;
 }
 
@@ -289,71 +594,47 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-void processInput(GLFWwindow* window, float deltaTime)
+// Klawisze symulacji trafiaja do input (stosuje je watek symulacji), reszta dziala od razu
+void processInput(GLFWwindow* window, SimulationInput& input)
 {
-    static bool keyPressed = false;
     static bool keyNPPressed = false;
     static bool keyGPPressed = false;
     static bool keyBPPressed = false;
+    static bool keyLPPressed = false;
+    static bool keyFPPressed = false;
+    static bool keyHPPressed = false;
+    static bool keyPPPressed = false;
+    static bool keyTPPressed = false;
 
 
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
     
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-        camera.ProcessKeyboard(UP, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
-        camera.ProcessKeyboard(DOWN, deltaTime);
-
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        camera.ProcessRoll(-1.0f);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        camera.ProcessRoll(1.0f);
-
-    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS && !keyPressed) {
-        activeCamera = DEFAULT;
-        keyPressed = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS && !keyPressed) {
-        activeCamera = TOP;
-        keyPressed = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS && !keyPressed) {
-        activeCamera = FOLLOW;
-        keyPressed = true;
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_RELEASE &&
-        glfwGetKey(window, GLFW_KEY_2) == GLFW_RELEASE &&
-        glfwGetKey(window, GLFW_KEY_3) == GLFW_RELEASE) {
-        keyPressed = false;
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-        headlightDirection.y += 0.005f;
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-        headlightDirection.y -= 0.005f;
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-        headlightDirection.x -= 0.005f;
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-        headlightDirection.x += 0.005f;
-
-    if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS) 
-        headlightIntensity = glm::min(1.0f, headlightIntensity + 0.005f);
-    if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
-        headlightIntensity = glm::max(0.0f, headlightIntensity - 0.005f);
-    
+    input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.backward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    input.up = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    input.down = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+
+    input.rollLeft = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+    input.rollRight = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+    input.mouse = mouseMovement;
+    mouseMovement = glm::vec2(0.0f);
+
+    input.cameraDefault = glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS;
+    input.cameraTop = glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS;
+    input.cameraFollow = glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS;
+
+    input.headlightUp = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS;
+    input.headlightDown = glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS;
+    input.headlightLeft = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+    input.headlightRight = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+    input.headlightBrighter = glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS;
+    input.headlightDimmer = glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS;
 
     if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS && !keyNPPressed) {
-        isNight = !isNight;
+        input.nightPresses++;
         keyNPPressed = true;
     }
     if (glfwGetKey(window, GLFW_KEY_N) == GLFW_RELEASE) {
@@ -376,6 +657,50 @@ void processInput(GLFWwindow* window, float deltaTime)
     if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE) {
         keyBPPressed = false;
     }
+
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !keyLPPressed) {
+        useLightBenchmark = !useLightBenchmark;
+        lightBenchmarkToggled = true;
+        std::cout << "Light benchmark (1000 lamps): " << (useLightBenchmark ? "ON" : "OFF") << std::endl;
+        keyLPPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE) {
+        keyLPPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !keyFPPressed) {
+        useDeferredShading = !useDeferredShading;
+        std::cout << "Deferred Shading: " << (useDeferredShading ? "ON" : "OFF") << std::endl;
+        keyFPPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE) {
+        keyFPPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !keyHPPressed) {
+        useShadowCache = !useShadowCache;
+        std::cout << "Static Shadow Cache: " << (useShadowCache ? "ON" : "OFF") << std::endl;
+        keyHPPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE) {
+        keyHPPressed = false;
+    }
+
+    // Profiler: P wypisuje podsumowanie, T zapisuje slad 300 klatek dla chrome://tracing
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !keyPPPressed) {
+        PROFILE_PRINT_SUMMARY();
+        keyPPPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE) {
+        keyPPPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && !keyTPPressed) {
+        PROFILE_CAPTURE_TRACE("profile_trace.json", 300);
+        keyTPPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE) {
+        keyTPPressed = false;
+    }
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -392,62 +717,56 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastX = xpos;
     lastY = ypos;
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    mouseMovement += glm::vec2(xoffset, yoffset);
 }
 
-void updateCarMovement(float deltaTime) {
-    static float turnProgress = 0.0f; 
-    static float currentSpeed = 6.0f;
-    float normalSpeed = 6.0f;
-    float turnSpeed = 2.0f;
-    float speedChangeRate = 3.0f;
-
-    float turnStartX = -63.5f; 
-    float turnEndX = -64.0f; 
-    float startZ = 1.5f; 
-    float endZ = 11.0f; 
-
-    switch (carState) {
-    case MOVING_FORWARD:
-        if (carPosition.x > turnStartX) {
-            carPosition.x -= currentSpeed * deltaTime; 
-        }
-        else {
-            carState = TURNING_RIGHT;
-            turnProgress = 0.0f;
-        }
-        break;
-
-    case TURNING_RIGHT:
-        if (turnProgress < 1.0f) {
-            currentSpeed = glm::mix(normalSpeed, turnSpeed, turnProgress);
-
-            float t = turnProgress;
-            float arcOffset = sin(t * glm::pi<float>()) * 1.0f;
-            carPosition.x = glm::mix(turnStartX, turnEndX, t);
-            carPosition.z = glm::mix(startZ, endZ, t) + arcOffset;
-            carRotation = glm::mix(-90.0f, 0.0f, t);
-
-            turnProgress += (currentSpeed / normalSpeed) * deltaTime * 0.7f;
-        }
-        else {
-            carPosition.x = turnEndX;
-            carPosition.z = endZ; 
-            carState = MOVING_FORWARD_AFTER_TURN;
-            currentSpeed = turnSpeed;
-        }
-        break;
+unsigned int findNormalMap(const Model& model)
+{
+    for (const Texture& tex : model.GetMeshes()[0].textures) {
+        if (tex.type == "texture_normal")
+            return tex.id;
+    }
+    return 0;
+}
 
-    case MOVING_FORWARD_AFTER_TURN:
-        currentSpeed = glm::mix(currentSpeed, normalSpeed, deltaTime * speedChangeRate);
-        carPosition.z += currentSpeed * deltaTime;
+// Siatka latarni nad cala plansza, kolory od cieplego do zimnego
+std::vector<Light> benchmarkLights(size_t count)
+{
+    std::vector<Light> result;
+    const int columns = 40;
+    for (size_t i = 0; i < count; i++) {
+        float x = -100.0f + 5.0f * static_cast<float>(i % columns);
+        float z = -40.0f + 5.0f * static_cast<float>(i / columns);
+        float t = static_cast<float>((i * 7919) % 101) / 100.0f;
+        StreetLamp lamp(glm::vec3(x, 2.3f, z),
+            glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::mix(glm::vec3(1.0f, 0.7f, 0.4f), glm::vec3(0.6f, 0.8f, 1.0f), t),
+            2.0f,
+            glm::cos(glm::radians(35.0f)),
+            glm::cos(glm::radians(35.5f)),
+            4.0f);
+        result.push_back(lamp.ToLight());
+    }
+    return result;
+}
 
-        if (carPosition.z > 48.0f) { 
-            carPosition = glm::vec3(55.0f, -1.78f, 2.0f);
-            carRotation = -90.0f;
-            carState = MOVING_FORWARD;
-            currentSpeed = normalSpeed;
+// Ten sam przydzial na jednym watku i na puli, srednia ze 100 przebiegow
+void benchmarkLightBinning(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, unsigned int threads)
+{
+    const int runs = 100;
+    unsigned int counts[2] = { 0, threads };
+    for (unsigned int helpers : counts) {
+        LightClusters clusters(helpers);
+        clusters.SetProjection(projection, 0.1f, LIGHT_CLUSTER_FAR);
+        double totalMs = 0.0;
+        for (int run = 0; run < runs; run++) {
+            clusters.Build(lights, view);
+            totalMs += clusters.GetStats().binMs;
         }
-        break;
+        const LightClusters::Stats& stats = clusters.GetStats();
+        std::cout << "Light binning, " << helpers + 1 << " thread(s): " << totalMs / runs << " ms for " << stats.lights
+            << " lights (" << stats.binnedLights << " visible), " << stats.references << " cluster references, "
+            << stats.occupiedClusters << " of " << LightClusters::CLUSTER_COUNT << " clusters lit, at most "
+            << stats.maxPerCluster << " per cluster" << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,201 @@
+// Offline converter: packs every models/*/textures directory into a textures.texpack
+// with precomputed mip chains and BCn copies, and verifies existing packs on the CPU.
+//
+//   TextureTranscoder <modelsDir>            build or rebuild the packs
+//   TextureTranscoder --verify <modelsDir>   check every pack against its source images
+
+#include "TexturePack.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool isImage(const fs::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp";
+}
+
+std::vector<fs::path> textureDirectories(const fs::path& root)
+{
+    std::vector<fs::path> dirs;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(root, ec), end; it != end; it.increment(ec)) {
+        if (ec) break;
+        if (it->is_directory() && it->path().filename() == "textures")
+            dirs.push_back(it->path());
+    }
+    std::sort(dirs.begin(), dirs.end());
+    return dirs;
+}
+
+std::vector<std::string> imagesIn(const fs::path& dir)
+{
+    std::vector<std::string> names;
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir)) {
+        if (entry.is_regular_file() && isImage(entry.path()))
+            names.push_back(entry.path().filename().string());
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+double psnr(const std::vector<unsigned char>& a, const unsigned char* b)
+{
+    double error = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        double d = double(a[i]) - double(b[i]);
+        error += d * d;
+    }
+    if (error == 0.0) return 99.0;
+    return 10.0 * std::log10(255.0 * 255.0 / (error / double(a.size())));
+}
+
+bool buildPack(const fs::path& dir, size_t& rawTotal, size_t& blockTotal)
+{
+    std::vector<TexturePackSource> sources;
+    size_t rawBytes = 0, vramBytes = 0;
+    for (const std::string& name : imagesIn(dir)) {
+        std::string path = (dir / name).string();
+        int width, height, components;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &components, 0);
+        if (!data) {
+            std::cout << "  skipped " << name << ": " << stbi_failure_reason() << std::endl;
+            continue;
+        }
+
+        TexturePackSource source;
+        source.name = name;
+        FileDigest(path, source.sourceHash, source.sourceSize);
+        source.components = static_cast<uint32_t>(components);
+        source.blockFormat = BlockFormatFor(source.components);
+        BuildMipChain(data, width, height, source.components, source.widths, source.heights, source.pixels);
+        stbi_image_free(data);
+
+        size_t levelRaw = 0, levelVram = 0;
+        for (size_t l = 0; l < source.pixels.size(); l++) {
+            levelRaw += source.pixels[l].size();
+            if (source.blockFormat != BLOCK_NONE) {
+                source.blocks.push_back(CompressBlocks(source.blockFormat, source.pixels[l].data(),
+                    source.widths[l], source.heights[l], source.components));
+                levelVram += source.blocks.back().size();
+            }
+        }
+        if (source.blockFormat == BLOCK_NONE) levelVram = levelRaw;
+        rawBytes += levelRaw;
+        vramBytes += levelVram;
+        std::cout << "  " << name << " " << width << "x" << height << "x" << components << ", "
+            << source.pixels.size() << " levels, " << levelRaw / 1024 << " KB raw -> " << levelVram / 1024 << " KB" << std::endl;
+        sources.push_back(std::move(source));
+    }
+
+    if (!TexturePack::Write(dir.string(), sources)) {
+        std::cout << "ERROR: could not write " << TexturePack::PackPathFor(dir.string()) << std::endl;
+        return false;
+    }
+    std::cout << dir.string() << ": " << sources.size() << " textures, VRAM " << rawBytes / 1024 << " KB uncompressed, "
+        << vramBytes / 1024 << " KB block-compressed" << std::endl;
+    rawTotal += rawBytes;
+    blockTotal += vramBytes;
+    return true;
+}
+
+bool verifyPack(const fs::path& dir)
+{
+    TexturePack pack;
+    if (!pack.Open(dir.string())) {
+        std::cout << "FAIL " << dir.string() << ": missing or unreadable pack" << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    for (const std::string& name : imagesIn(dir)) {
+        const TexturePackEntry* entry = pack.Find(name);
+        if (!entry) {
+            std::cout << "FAIL " << name << ": not in pack or stale" << std::endl;
+            ok = false;
+            continue;
+        }
+
+        int width, height, components;
+        unsigned char* data = stbi_load((dir / name).string().c_str(), &width, &height, &components, 0);
+        if (!data) continue;
+        std::vector<unsigned char> source(data, data + size_t(width) * height * components);
+        stbi_image_free(data);
+
+        std::string error;
+        if (entry->width != uint32_t(width) || entry->height != uint32_t(height) || entry->components != uint32_t(components))
+            error = "header does not match source";
+        else if (entry->levels.empty() || entry->levels[0].pixelBytes != source.size() ||
+            !std::equal(source.begin(), source.end(), entry->levels[0].pixels))
+            error = "level 0 does not match source pixels";
+
+        uint32_t w = entry->width, h = entry->height;
+        for (size_t l = 0; error.empty() && l < entry->levels.size(); l++) {
+            const TextureLevel& level = entry->levels[l];
+            if (level.width != w || level.height != h || level.pixelBytes != size_t(w) * h * components)
+                error = "level " + std::to_string(l) + " has wrong size";
+            else if (level.blockBytes != BlockBytes(entry->blockFormat, w, h))
+                error = "level " + std::to_string(l) + " has wrong block payload size";
+            w = std::max(1u, w / 2);
+            h = std::max(1u, h / 2);
+        }
+        if (error.empty() && (entry->levels.back().width != 1 || entry->levels.back().height != 1))
+            error = "mip chain does not end at 1x1";
+
+        double quality = 0.0;
+        if (error.empty() && entry->blockFormat != BLOCK_NONE) {
+            const TextureLevel& level = entry->levels[0];
+            std::vector<unsigned char> decoded = DecompressBlocks(entry->blockFormat, level.blocks,
+                level.width, level.height, entry->components);
+            quality = psnr(decoded, level.pixels);
+            if (quality < 20.0)
+                error = "block payload PSNR " + std::to_string(quality) + " dB";
+        }
+
+        if (!error.empty()) {
+            std::cout << "FAIL " << name << ": " << error << std::endl;
+            ok = false;
+        }
+        else {
+            std::cout << "ok   " << name << " (" << entry->levels.size() << " levels";
+            if (entry->blockFormat != BLOCK_NONE) std::cout << ", BC PSNR " << quality << " dB";
+            std::cout << ")" << std::endl;
+        }
+    }
+    return ok;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    bool verify = argc == 3 && std::string(argv[1]) == "--verify";
+    if (argc != 2 && !verify) {
+        std::cout << "usage: TextureTranscoder [--verify] <modelsDir>" << std::endl;
+        return 2;
+    }
+    fs::path root = argv[argc - 1];
+    std::vector<fs::path> dirs = textureDirectories(root);
+    if (dirs.empty()) {
+        std::cout << "no textures/ directories under " << root.string() << std::endl;
+        return 1;
+    }
+
+    bool ok = true;
+    size_t rawTotal = 0, blockTotal = 0;
+    for (const fs::path& dir : dirs)
+        ok = (verify ? verifyPack(dir) : buildPack(dir, rawTotal, blockTotal)) && ok;
+    if (!verify)
+        std::cout << "Total VRAM: " << rawTotal / 1024 << " KB uncompressed -> " << blockTotal / 1024 << " KB block-compressed" << std::endl;
+    return ok ? 0 : 1;
+}